@@ -0,0 +1,45 @@
+#pragma once
+#include "libbndl_export.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace libbndl
+{
+	// Recycles byte buffers in power-of-two size classes, so reading many resources doesn't
+	// allocate (and page fault) a fresh buffer every time. Buffers go back to the pool when their
+	// handle is released, even if the pool itself is gone by then. Thread-safe.
+	class BufferPool
+	{
+		struct State;
+
+	public:
+		class Recycler
+		{
+		public:
+			Recycler() = default;
+			explicit Recycler(std::shared_ptr<State> state) : m_state(std::move(state)) {}
+
+			LIBBNDL_EXPORT void operator()(std::vector<uint8_t> *buffer) const;
+
+		private:
+			std::shared_ptr<State> m_state;
+		};
+
+		using Buffer = std::unique_ptr<std::vector<uint8_t>, Recycler>;
+
+		// At most maxCachedBytes of capacity is kept on the freelists; anything beyond is freed.
+		LIBBNDL_EXPORT explicit BufferPool(size_t maxCachedBytes = 256 * 1024 * 1024);
+
+		// A buffer of exactly size bytes. Its contents are unspecified.
+		LIBBNDL_EXPORT Buffer Acquire(size_t size);
+
+		// Frees all cached buffers.
+		LIBBNDL_EXPORT void Trim();
+
+		LIBBNDL_EXPORT size_t GetCachedBytes() const;
+
+	private:
+		std::shared_ptr<State> m_state;
+	};
+}
@@ -1,22 +1,34 @@
 #pragma once
 #include "libbndl_export.h"
+#include "hash.hpp"
+#include "buffer_pool.hpp"
 #include <string>
+#include <string_view>
 #include <map>
+#include <iterator>
+#include <unordered_set>
+#include <unordered_map>
+#include <array>
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <optional>
+#include <functional>
 
 namespace binaryio
 {
-	class BinaryReader;
 	class BinaryWriter;
 }
 
 namespace libbndl
 {
+	class BundlePatch;
+
 	class Bundle
 	{
+		friend class BundlePatch;
+
 	public:
 		enum MagicVersion
 		{
@@ -165,6 +177,9 @@ namespace libbndl
 			uint32_t uncompressedAlignment; // default depending on file type
 			uint32_t compressedSize;
 			std::unique_ptr<std::vector<uint8_t>> data;
+			// Edited in a compressed bundle with deferred compression: data is still uncompressed
+			// (compressedSize is 0) and gets compressed on Save.
+			bool compressionDeferred = false;
 		};
 
 		struct EntryDebugInfo
@@ -173,6 +188,13 @@ namespace libbndl
 			std::string typeName;
 		};
 
+		// Views into the bundle's interned string pool. Valid until the bundle is loaded again.
+		struct EntryDebugInfoView
+		{
+			std::string_view name;
+			std::string_view typeName;
+		};
+
 		struct EntryInfo
 		{
 			uint32_t checksum; // Stored in bundle as 64-bit (8-byte)
@@ -192,9 +214,33 @@ namespace libbndl
 		{
 			EntryInfo info;
 			EntryFileBlockData fileBlockData[3];
+			// Added or replaced since the bundle was loaded. Unmodified entries are saved with their
+			// stored (compressed) bytes as they are.
+			bool modified = false;
 		};
 
 
+		// Totals since the bundle was created or the statistics were reset.
+		struct Statistics
+		{
+			uint64_t bytesRead; // from disk, by Load
+			uint64_t bytesInflated;
+			uint64_t bytesDeflated; // uncompressed bytes that went into compression
+			uint64_t inflateNanoseconds;
+			uint64_t deflateNanoseconds;
+			uint64_t debugInfoParseNanoseconds;
+			uint64_t bytesAllocated; // for loaded, decompressed and compressed data
+			// Reads through GetBinary and the other block accessors.
+			std::map<ResourceType, uint64_t> getBinaryCalls;
+		};
+
+		struct VerifyIssue
+		{
+			uint32_t resourceID;
+			int32_t fileBlock; // -1 if it's not about a single block
+			std::string message;
+		};
+
 		struct EntryData
 		{
 			std::unique_ptr<std::vector<uint8_t>> fileBlockData[3];
@@ -203,10 +249,70 @@ namespace libbndl
 		};
 
 
+		enum class ExecutionPolicy
+		{
+			Sequential,
+			Parallel
+		};
+
+		// Iterates the resource IDs in ascending order without copying them.
+		class ResourceIDView
+		{
+		public:
+			class Iterator
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = uint32_t;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const uint32_t *;
+				using reference = const uint32_t &;
+
+				Iterator() = default;
+				explicit Iterator(std::map<uint32_t, Entry>::const_iterator it) : m_it(it) {}
+
+				reference operator*() const { return m_it->first; }
+				pointer operator->() const { return &m_it->first; }
+				Iterator &operator++() { ++m_it; return *this; }
+				Iterator operator++(int) { auto it = *this; ++m_it; return it; }
+				bool operator==(const Iterator &other) const { return m_it == other.m_it; }
+				bool operator!=(const Iterator &other) const { return m_it != other.m_it; }
+
+			private:
+				std::map<uint32_t, Entry>::const_iterator m_it;
+			};
+
+			explicit ResourceIDView(const std::map<uint32_t, Entry> &entries) : m_entries(&entries) {}
+
+			Iterator begin() const { return Iterator(m_entries->begin()); }
+			Iterator end() const { return Iterator(m_entries->end()); }
+			size_t size() const { return m_entries->size(); }
+			bool empty() const { return m_entries->empty(); }
+
+		private:
+			const std::map<uint32_t, Entry> *m_entries;
+		};
+
 		LIBBNDL_EXPORT Bundle() = default;
 		LIBBNDL_EXPORT Bundle(MagicVersion magicVersion, uint32_t revisionNumber, Platform platform, Flags flags); // For creating new bundles
+		// Moving leaves the source an empty bundle, which can be loaded or filled again.
+		LIBBNDL_EXPORT Bundle(Bundle &&other);
+		LIBBNDL_EXPORT Bundle &operator=(Bundle &&other);
+
+		struct LoadOptions
+		{
+			// Data of these resource types is skipped (deny list) or is the only data loaded (allow
+			// list). Filtered entries keep their metadata but have no data, and can't be saved.
+			std::vector<ResourceType> resourceTypes;
+			bool denyResourceTypes = true;
+			// Which of the three file blocks to load at all. BND2 keeps dependencies at the end of
+			// the first block, so they aren't available for entries whose first block is skipped.
+			bool fileBlocks[3] = { true, true, true };
+		};
 
 		LIBBNDL_EXPORT bool Load(const std::string &name);
+		LIBBNDL_EXPORT bool Load(const std::string &name, const LoadOptions &options);
+		// Fails if the bundle would be 4 GiB or larger, since offsets are stored in 32 bits.
 		LIBBNDL_EXPORT bool Save(const std::string &name);
 
 		LIBBNDL_EXPORT MagicVersion GetMagicVersion() const
@@ -229,44 +335,296 @@ namespace libbndl
 			return m_flags;
 		}
 
-		LIBBNDL_EXPORT std::optional<EntryDebugInfo> GetDebugInfo(const std::string &resourceName) const;
+		// Same as libbndl::HashResourceName, but lowercases in chunks and hashes with zlib's
+		// table-driven CRC32, without allocating.
+		LIBBNDL_EXPORT static uint32_t HashResourceName(std::string_view resourceName);
+		// The ResourceType enumerator's name, or empty for unknown types.
+		LIBBNDL_EXPORT static std::string_view GetResourceTypeName(ResourceType resourceType);
+
+		LIBBNDL_EXPORT std::optional<EntryDebugInfo> GetDebugInfo(std::string_view resourceName) const;
 		LIBBNDL_EXPORT std::optional<EntryDebugInfo> GetDebugInfo(uint32_t resourceID) const;
-		LIBBNDL_EXPORT std::optional<ResourceType> GetResourceType(const std::string &resourceName) const;
+		LIBBNDL_EXPORT std::optional<EntryDebugInfoView> GetDebugInfoView(std::string_view resourceName) const;
+		LIBBNDL_EXPORT std::optional<EntryDebugInfoView> GetDebugInfoView(uint32_t resourceID) const;
+		LIBBNDL_EXPORT std::optional<ResourceType> GetResourceType(std::string_view resourceName) const;
 		LIBBNDL_EXPORT std::optional<ResourceType> GetResourceType(uint32_t resourceID) const;
-		LIBBNDL_EXPORT std::optional<EntryData> GetData(const std::string &resourceName) const;
+		// Size of the block once decompressed, without reading it. For BND2 block 0 this includes the dependency table.
+		LIBBNDL_EXPORT std::optional<uint32_t> GetUncompressedSize(uint32_t resourceID, uint32_t fileBlock) const;
+		LIBBNDL_EXPORT std::optional<EntryData> GetData(std::string_view resourceName) const;
 		LIBBNDL_EXPORT std::optional<EntryData> GetData(uint32_t resourceID) const;
-		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinary(const std::string &resourceName, uint32_t fileBlock) const;
+		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinary(std::string_view resourceName, uint32_t fileBlock) const;
 		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinary(uint32_t resourceID, uint32_t fileBlock) const;
 
-		LIBBNDL_EXPORT bool AddResource(const std::string &resourceName, const EntryData &data, ResourceType resourceType);
+		// Buffers from GetPooledBinary come from this pool and return to it when released. GetBinary
+		// and GetData hand their buffers over for good, so they never use it.
+		LIBBNDL_EXPORT void SetBufferPool(std::shared_ptr<BufferPool> bufferPool)
+		{
+			m_bufferPool = std::move(bufferPool);
+		}
+		LIBBNDL_EXPORT const std::shared_ptr<BufferPool> &GetBufferPool() const
+		{
+			return m_bufferPool;
+		}
+		// Same as GetBinary, but the buffer comes from the buffer pool if one is set.
+		LIBBNDL_EXPORT BufferPool::Buffer GetPooledBinary(std::string_view resourceName, uint32_t fileBlock) const;
+		LIBBNDL_EXPORT BufferPool::Buffer GetPooledBinary(uint32_t resourceID, uint32_t fileBlock) const;
+
+		// The first size bytes of a block (or all of it, if smaller). Inflating stops there, so this
+		// is cheap for reading resource headers.
+		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinaryPrefix(std::string_view resourceName, uint32_t fileBlock, size_t size) const;
+		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinaryPrefix(uint32_t resourceID, uint32_t fileBlock, size_t size) const;
+
+		// Receives a block chunk by chunk; return false to stop early.
+		using BinarySink = std::function<bool(const uint8_t *data, size_t size)>;
+		// Like GetBinary, but inflates the block in chunks of at most chunkSize bytes and hands each
+		// one to the sink before inflating the next, so memory use doesn't grow with the block.
+		// Returns false if the resource doesn't exist, its data is corrupt or the block was filtered
+		// out on load. Empty blocks return true without calling the sink.
+		LIBBNDL_EXPORT bool StreamBinary(std::string_view resourceName, uint32_t fileBlock, const BinarySink &sink, size_t chunkSize = 64 * 1024) const;
+		LIBBNDL_EXPORT bool StreamBinary(uint32_t resourceID, uint32_t fileBlock, const BinarySink &sink, size_t chunkSize = 64 * 1024) const;
+
+		// Dependency graph queries. BND2 dependency tables are read from all entries on first use.
+		// Imports: what resourceID depends on.
+		LIBBNDL_EXPORT const std::vector<Dependency> &GetDependencies(uint32_t resourceID) const;
+		// Entries in this bundle that import resourceID.
+		LIBBNDL_EXPORT const std::vector<uint32_t> &GetDependents(uint32_t resourceID) const;
+		// Everything resourceID depends on, directly or not, sorted by ID. Never includes resourceID
+		// itself, even when it's part of a dependency cycle.
+		LIBBNDL_EXPORT std::vector<uint32_t> GetTransitiveDependencies(uint32_t resourceID) const;
+		// All entries, each after the entries it depends on.
+		LIBBNDL_EXPORT std::vector<uint32_t> GetLoadOrder() const;
+
+		LIBBNDL_EXPORT bool AddResource(std::string_view resourceName, const EntryData &data, ResourceType resourceType);
 		LIBBNDL_EXPORT bool AddResource(uint32_t resourceID, const EntryData &data, ResourceType resourceType);
-		LIBBNDL_EXPORT bool AddDebugInfo(const std::string &resourceName, const std::string &name, const std::string &type);
-		LIBBNDL_EXPORT bool AddDebugInfo(uint32_t resourceID, const std::string &name, const std::string &type);
+		// Take ownership of data's buffers instead of copying them. BND2 dependencies are appended
+		// to the first block in place.
+		LIBBNDL_EXPORT bool AddResource(std::string_view resourceName, EntryData &&data, ResourceType resourceType);
+		LIBBNDL_EXPORT bool AddResource(uint32_t resourceID, EntryData &&data, ResourceType resourceType);
+		LIBBNDL_EXPORT bool AddDebugInfo(std::string_view resourceName, std::string_view name, std::string_view type);
+		LIBBNDL_EXPORT bool AddDebugInfo(uint32_t resourceID, std::string_view name, std::string_view type);
 
-		LIBBNDL_EXPORT bool ReplaceResource(const std::string &resourceName, const EntryData &data);
+		// For bundles without a string table: hashes every candidate name (on threadCount threads,
+		// 0 for all hardware threads) and attaches the ones matching an unnamed resource as its debug
+		// info. Returns the number of resources that were named.
+		LIBBNDL_EXPORT size_t RecoverDebugInfo(const std::vector<std::string_view> &candidateNames, uint32_t threadCount = 0);
+
+		LIBBNDL_EXPORT bool ReplaceResource(std::string_view resourceName, const EntryData &data);
 		LIBBNDL_EXPORT bool ReplaceResource(uint32_t resourceID, const EntryData &data);
+		// In compressed bundles, keep added and replaced blocks uncompressed until Save, which then
+		// compresses only those blocks, in parallel. Off by default.
+		LIBBNDL_EXPORT void SetDeferredCompression(bool deferred)
+		{
+			m_deferredCompression = deferred;
+		}
+		LIBBNDL_EXPORT bool GetDeferredCompression() const
+		{
+			return m_deferredCompression;
+		}
+		// Compresses the blocks deferred so far on threadCount threads (0 for all hardware threads)
+		// instead of leaving them for Save, so callers adding many resources in batches only keep
+		// compressed data around.
+		LIBBNDL_EXPORT bool CompressDeferredBlocks(uint32_t threadCount = 0);
+
+		LIBBNDL_EXPORT bool ReplaceResource(std::string_view resourceName, EntryData &&data);
+		LIBBNDL_EXPORT bool ReplaceResource(uint32_t resourceID, EntryData &&data);
+
+		// XXH64 of a block's uncompressed bytes, inflated in chunks without keeping them. Unlike the
+		// stored checksum, this is a real content hash: usable as a cache key, for change detection
+		// and for deduplicating across bundles. Results are cached until the resource is replaced.
+		// Empty if the resource doesn't exist or its data is corrupt or wasn't loaded.
+		LIBBNDL_EXPORT std::optional<uint64_t> GetContentHash(uint32_t resourceID, uint32_t fileBlock) const;
+		// All three blocks combined.
+		LIBBNDL_EXPORT std::optional<uint64_t> GetContentHash(uint32_t resourceID) const;
+		LIBBNDL_EXPORT std::optional<uint64_t> GetContentHash(std::string_view resourceName) const;
+		// Hashes all resources that aren't cached yet on threadCount threads (0 for all hardware threads).
+		LIBBNDL_EXPORT void PrecomputeContentHashes(uint32_t threadCount = 0) const;
+
+		// The counters are relaxed atomics, so collecting them costs next to nothing.
+		LIBBNDL_EXPORT Statistics GetStatistics() const;
+		LIBBNDL_EXPORT void ResetStatistics();
+		// Called with the statistics after every Load and Save.
+		using StatisticsCallback = std::function<void(const Statistics &statistics)>;
+		LIBBNDL_EXPORT void SetStatisticsCallback(StatisticsCallback callback)
+		{
+			m_statisticsCallback = std::move(callback);
+		}
+
+		// Checks every resource on threadCount threads (0 for all hardware threads): stored sizes match
+		// the data, compressed blocks inflate to exactly their uncompressed size, alignments are powers
+		// of two, dependency tables can be read, and string table entries belong to a resource. File
+		// offsets were already bounds checked by Load. Returns the problems found, empty if none.
+		LIBBNDL_EXPORT std::vector<VerifyIssue> Verify(uint32_t threadCount = 0) const;
+
+		// Records the order resources are first read in (through GetBinary, GetData, StreamBinary and
+		// the other block accessors), e.g. while running the game or a server, for SetDataLayout.
+		LIBBNDL_EXPORT void StartAccessTrace();
+		LIBBNDL_EXPORT void StopAccessTrace();
+		LIBBNDL_EXPORT std::vector<uint32_t> GetAccessTrace() const;
+
+		// Save writes the data blocks of these resources first, in this order, and the rest after
+		// them in ID order, so reads in that order are sequential. Empty (the default) for ID order.
+		LIBBNDL_EXPORT void SetDataLayout(std::vector<uint32_t> resourceIDs)
+		{
+			m_dataLayout = std::move(resourceIDs);
+		}
+		LIBBNDL_EXPORT const std::vector<uint32_t> &GetDataLayout() const
+		{
+			return m_dataLayout;
+		}
+
+		LIBBNDL_EXPORT bool IsModified(std::string_view resourceName) const;
+		LIBBNDL_EXPORT bool IsModified(uint32_t resourceID) const;
+		// IDs of all resources added or replaced since the bundle was loaded, sorted.
+		LIBBNDL_EXPORT std::vector<uint32_t> ListModifiedResources() const;
 
 		LIBBNDL_EXPORT std::vector<uint32_t> ListResourceIDs() const;
 		LIBBNDL_EXPORT std::map<ResourceType, std::vector<uint32_t>> ListResourceIDsByType() const;
 
+		// Allocation-free variants of the above. The references stay valid until the bundle is
+		// loaded again or resources are added.
+		LIBBNDL_EXPORT ResourceIDView GetResourceIDs() const
+		{
+			return ResourceIDView(m_entries);
+		}
+		// Sorted IDs of all resources of this type.
+		LIBBNDL_EXPORT const std::vector<uint32_t> &GetResourceIDsByType(ResourceType resourceType) const;
+		LIBBNDL_EXPORT const std::map<ResourceType, std::vector<uint32_t>> &GetResourceTypeIndex() const
+		{
+			return m_entriesByType;
+		}
+
+		// Calls visitor(resourceID, info) for every resource. With the parallel policy the visitor is
+		// called from threadCount threads (0 for all hardware threads) and must be thread-safe.
+		LIBBNDL_EXPORT void ForEachResource(const std::function<void(uint32_t, const EntryInfo &)> &visitor,
+			ExecutionPolicy policy = ExecutionPolicy::Sequential, uint32_t threadCount = 0) const;
+
 	private:
+		// Interns strings in large chunks, so repeated type names are only stored once and the
+		// views handed out stay valid until Clear.
+		class StringPool
+		{
+		public:
+			std::string_view Intern(std::string_view str);
+			void Clear();
+
+		private:
+			static constexpr size_t ChunkSize = 64 * 1024;
+
+			std::vector<std::unique_ptr<char[]>> m_chunks;
+			char *m_chunkHead = nullptr;
+			size_t m_chunkRemaining = 0;
+			std::unordered_set<std::string_view> m_strings;
+		};
+
 		std::map<uint32_t, Entry>	m_entries;
-		std::map<uint32_t, EntryDebugInfo> m_debugInfoEntries;
-		std::map<uint32_t, std::vector<Dependency>> m_dependencies; // not used in bnd2 due to lazy reading.
-
-		MagicVersion				m_magicVersion;
-		uint32_t					m_revisionNumber;
-		Platform					m_platform;
-		Flags						m_flags;
-
-		bool LoadBND2(binaryio::BinaryReader &reader);
-		bool LoadBNDL(binaryio::BinaryReader &reader);
-		bool SaveBND2(binaryio::BinaryWriter &writer);
-		bool SaveBNDL(binaryio::BinaryWriter &writer);
+		// Resource IDs by type, kept sorted as entries are loaded and added.
+		std::map<ResourceType, std::vector<uint32_t>> m_entriesByType;
+
+		std::shared_ptr<BufferPool>	m_bufferPool;
+		bool						m_deferredCompression = false;
+
+		struct StatisticsCounters
+		{
+			std::atomic<uint64_t> bytesRead = 0;
+			std::atomic<uint64_t> bytesInflated = 0;
+			std::atomic<uint64_t> bytesDeflated = 0;
+			std::atomic<uint64_t> inflateNanoseconds = 0;
+			std::atomic<uint64_t> deflateNanoseconds = 0;
+			std::atomic<uint64_t> debugInfoParseNanoseconds = 0;
+			std::atomic<uint64_t> bytesAllocated = 0;
+		};
+		// Mutexes and atomics can't be moved, so they live on the heap to keep the bundle movable.
+		struct SyncState
+		{
+			StatisticsCounters statistics;
+			std::mutex contentHashMutex;
+			std::atomic<bool> accessTracing = false;
+			std::mutex accessTraceMutex;
+			std::atomic<bool> dependenciesPending = false;
+			std::mutex dependencyMutex;
+			std::atomic<bool> debugInfoPending = false;
+			std::mutex debugInfoMutex;
+		};
+		std::unique_ptr<SyncState>	m_sync = std::make_unique<SyncState>();
+		// One counter per type in the bundle, created when entries are loaded or added so reads
+		// only ever look them up.
+		mutable std::map<ResourceType, std::atomic<uint64_t>> m_getBinaryCalls;
+		StatisticsCallback			m_statisticsCallback;
+
+		// Content hashes of all three blocks, by resource ID.
+		mutable std::unordered_map<uint32_t, std::array<uint64_t, 3>> m_contentHashes;
+
+		std::vector<uint32_t>		m_dataLayout;
+		mutable std::vector<uint32_t> m_accessTrace;
+		mutable std::unordered_set<uint32_t> m_accessTraced;
+
+		// Dependency graph. BNDL stores the tables separately, BND2 at the end of each block 0, so
+		// for BND2 these are only read on first use.
+		mutable std::map<uint32_t, std::vector<Dependency>> m_dependencies;
+		mutable std::map<uint32_t, std::vector<uint32_t>> m_dependents;
+		mutable bool				m_dependentsValid = false;
+
+		// Debug info is parsed from the stored ResourceStringTable on first access.
+		mutable std::map<uint32_t, EntryDebugInfoView> m_debugInfoEntries;
+		mutable StringPool			m_debugStrings;
+		mutable EntryFileBlockData	m_resourceStringTable {};
+
+		MagicVersion				m_magicVersion = BND2;
+		uint32_t					m_revisionNumber = 0;
+		Platform					m_platform = PC;
+		Flags						m_flags = static_cast<Flags>(0);
+
+		struct LoadContext;
+		template <bool BigEndian>
+		bool LoadBND2(LoadContext &context);
+		template <bool BigEndian>
+		bool LoadBNDL(LoadContext &context);
+		// Where Save puts each block of resource data. The headers and tables are built in memory,
+		// but the data is written to the file straight from the entries.
+		struct SaveLayout
+		{
+			struct Write
+			{
+				uint64_t offset;
+				const uint8_t *data;
+				size_t size;
+			};
+			std::vector<Write> writes;
+			uint64_t fileSize = 0;
+			// Data that isn't stored in an entry, like the BNDL resource string table.
+			std::vector<std::unique_ptr<std::vector<uint8_t>>> buffers;
+		};
+		bool SaveBND2(binaryio::BinaryWriter &writer, SaveLayout &layout);
+		bool SaveBNDL(binaryio::BinaryWriter &writer, SaveLayout &layout);
 		int8_t MapBNDLBlockToBND2(uint8_t block) const;
-		uint32_t HashResourceName(std::string resourceName) const;
+		std::unique_ptr<std::vector<uint8_t>> DecompressBlock(const EntryFileBlockData &dataInfo) const;
+		bool DecompressBlock(const EntryFileBlockData &dataInfo, uint8_t *out) const;
+		bool InflateBlock(const EntryFileBlockData &dataInfo, size_t chunkSize, const BinarySink &sink) const;
+		void LoadDependencies() const;
+		bool ReadBND2Dependencies(const Entry &e, std::vector<Dependency> &dependencies) const;
+		void ClearDependencies();
+		void LoadDebugInfo() const;
+		void ParseResourceStringTable(std::string_view xml) const;
+		void ClearDebugInfo();
+
+		void Swap(Bundle &other);
+		void RebuildTypeIndex();
+		void TraceAccess(uint32_t resourceID) const;
+		void CountGetBinary(ResourceType resourceType) const;
+		void ReportStatistics() const;
+		std::optional<std::array<uint64_t, 3>> GetContentHashes(uint32_t resourceID) const;
+		bool HashContent(const Entry &e, std::array<uint64_t, 3> &hashes) const;
+		void VerifyEntry(uint32_t resourceID, const Entry &e, std::vector<VerifyIssue> &issues) const;
+		std::vector<std::map<uint32_t, Entry>::const_iterator> GetDataLayoutOrder() const;
+
+		bool AddEntry(uint32_t resourceID, const EntryData &data, ResourceType resourceType);
+		Entry *BeginReplaceResource(uint32_t resourceID, const std::vector<Dependency> &dependencies);
+		bool StoreBlock(Entry &e, int fileBlock, const std::vector<uint8_t> *source, std::unique_ptr<std::vector<uint8_t>> owned,
+			const std::vector<Dependency> &dependencies, uint32_t alignment);
+		bool CompressBlock(const std::vector<uint8_t> &source, EntryFileBlockData &dataInfo) const;
 
-		static Dependency ReadDependency(binaryio::BinaryReader &reader);
-		static void WriteDependency(binaryio::BinaryWriter &writer, const Dependency &dependency);
+		template <bool BigEndian>
+		static void ReadDependencies(const uint8_t *data, uint32_t count, std::vector<Dependency> &dependencies);
+		template <bool BigEndian>
+		static void WriteDependencies(uint8_t *data, const std::vector<Dependency> &dependencies);
 	};
 }
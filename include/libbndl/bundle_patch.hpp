@@ -0,0 +1,79 @@
+#pragma once
+#include "libbndl_export.h"
+#include "bundle.hpp"
+#include <string>
+#include <vector>
+
+namespace libbndl
+{
+	// The resources that differ between two versions of a bundle, in their stored (compressed)
+	// form. Applying the patch to the old bundle reproduces the new one exactly.
+	class BundlePatch
+	{
+	public:
+		// Compares the bundles entry by entry, by metadata and a hash of the stored blocks. Fails if
+		// either bundle was loaded with filtered out data.
+		LIBBNDL_EXPORT bool Create(const Bundle &from, const Bundle &to);
+
+		// Fails without touching the bundle unless it is exactly the bundle the patch was made from.
+		LIBBNDL_EXPORT bool Apply(Bundle &bundle) const;
+
+		LIBBNDL_EXPORT bool Load(const std::string &name);
+		LIBBNDL_EXPORT bool Save(const std::string &name) const;
+
+		LIBBNDL_EXPORT const std::vector<uint32_t> &GetRemovedResources() const
+		{
+			return m_removedResources;
+		}
+		// Added or changed resources.
+		LIBBNDL_EXPORT std::vector<uint32_t> GetChangedResources() const;
+
+	private:
+		struct Header
+		{
+			Bundle::MagicVersion magicVersion;
+			uint32_t revisionNumber;
+			Bundle::Platform platform;
+			Bundle::Flags flags;
+		};
+
+		struct Block
+		{
+			uint32_t uncompressedSize;
+			uint32_t uncompressedAlignment;
+			uint32_t compressedSize;
+			bool compressionDeferred;
+			bool hasData;
+			std::vector<uint8_t> data;
+		};
+
+		struct Resource
+		{
+			uint32_t resourceID;
+			Bundle::EntryInfo info;
+			Block fileBlockData[3];
+			std::vector<Bundle::Dependency> dependencies; // BNDL only; BND2 keeps them in block 0
+		};
+
+		struct DebugInfoChange
+		{
+			uint32_t resourceID;
+			bool present;
+			std::string name;
+			std::string typeName;
+		};
+
+		static Header GetHeader(const Bundle &bundle);
+		static bool HasAllData(const Bundle &bundle);
+		static uint64_t HashEntry(const Bundle &bundle, uint32_t resourceID, const Bundle::Entry &entry);
+		static std::vector<uint64_t> HashEntries(const Bundle &bundle);
+		static uint64_t Fingerprint(const Bundle &bundle, const std::vector<uint64_t> &entryHashes);
+
+		Header m_from {};
+		Header m_to {};
+		uint64_t m_fromFingerprint = 0;
+		std::vector<uint32_t> m_removedResources;
+		std::vector<Resource> m_resources;
+		std::vector<DebugInfoChange> m_debugInfoChanges;
+	};
+}
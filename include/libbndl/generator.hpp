@@ -0,0 +1,43 @@
+#pragma once
+#include "libbndl_export.h"
+#include "bundle.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace libbndl
+{
+	// Describes a synthetic bundle for load and scale testing. The same options and seed always
+	// produce the same bundle, whatever the thread count.
+	struct GeneratorOptions
+	{
+		Bundle::MagicVersion magicVersion = Bundle::BND2;
+		uint32_t revisionNumber = 0; // 0 for the newest: 2 for BND2, 5 for BNDL
+		Bundle::Platform platform = Bundle::PC; // BND2 can only be saved for PC
+		bool compressed = false;
+
+		uint32_t resourceCount = 1000;
+		// Block sizes are uniformly distributed in [min, max]. Blocks with a max of 0 are left empty.
+		uint32_t minBlockSizes[3] = { 64, 0, 0 };
+		uint32_t maxBlockSizes[3] = { 16 * 1024, 64 * 1024, 0 };
+		// Data is made of byte runs of up to this length: 1 is incompressible, longer runs compress better.
+		uint32_t maxRunLength = 8;
+		// Average number of dependencies per resource, on resources generated before it.
+		double dependencyDensity = 1.0;
+		bool resourceStringTable = true;
+		// Resources cycle through these types.
+		std::vector<Bundle::ResourceType> resourceTypes = { Bundle::Raster, Bundle::Material, Bundle::Renderable,
+			Bundle::VertexDesc, Bundle::AttribSysVault };
+
+		uint64_t seed = 0;
+		uint32_t threadCount = 0; // for generating and compressing the data; 0 for all hardware threads
+	};
+
+	// Resources are named "generated://<type name>/<index>" and IDed by the hash of the name.
+	// Compressed bundles are compressed in parallel a batch at a time as they're generated, and come
+	// back with deferred compression on. Returns nullptr for combinations Save can't write: non-PC
+	// BND2 or compressed BNDL before revision 4. Save also refuses bundles of 4 GiB or more.
+	LIBBNDL_EXPORT std::unique_ptr<Bundle> GenerateBundle(const GeneratorOptions &options);
+
+	LIBBNDL_EXPORT bool GenerateBundle(const GeneratorOptions &options, const std::string &fileName);
+}
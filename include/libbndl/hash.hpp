@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace libbndl
+{
+	namespace detail
+	{
+		constexpr std::array<uint32_t, 256> MakeCRC32Table()
+		{
+			std::array<uint32_t, 256> table {};
+			for (auto i = 0U; i < 256; i++)
+			{
+				auto crc = i;
+				for (auto bit = 0; bit < 8; bit++)
+					crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : (crc >> 1);
+				table[i] = crc;
+			}
+			return table;
+		}
+
+		inline constexpr auto CRC32Table = MakeCRC32Table();
+	}
+
+	// Resource IDs are the CRC32 of the lowercased (ASCII) resource name. This version can run at
+	// compile time, so well-known names become constants:
+	//     constexpr auto id = libbndl::HashResourceName("gamedb://burnout5/...");
+	// Bundle::HashResourceName gives the same result and is faster at runtime.
+	constexpr uint32_t HashResourceName(std::string_view resourceName)
+	{
+		auto crc = 0xFFFFFFFFU;
+		for (const auto c : resourceName)
+		{
+			const auto lower = static_cast<uint8_t>((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+			crc = detail::CRC32Table[(crc ^ lower) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+}
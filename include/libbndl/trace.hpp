@@ -0,0 +1,16 @@
+#pragma once
+#include "libbndl_export.h"
+#include <string>
+
+namespace libbndl
+{
+	// Records where the library spends its time (load and save phases, block inflation) as a
+	// Chrome trace, viewable in chrome://tracing or Perfetto. Tracing is off by default and covers
+	// every bundle in the process while it runs. Spans are kept in memory until StopTracing.
+
+	// Fails if tracing is already running or the file can't be created.
+	LIBBNDL_EXPORT bool StartTracing(const std::string &fileName);
+	// Writes the trace file. Fails if tracing wasn't running or the file couldn't be written.
+	LIBBNDL_EXPORT bool StopTracing();
+	LIBBNDL_EXPORT bool IsTracing();
+}
@@ -0,0 +1,105 @@
+#include <libbndl/buffer_pool.hpp>
+#include <array>
+#include <mutex>
+
+using namespace libbndl;
+
+namespace
+{
+	// Classes are 256 bytes to 1 GiB; larger buffers aren't pooled.
+	constexpr size_t MinClassShift = 8;
+	constexpr size_t MaxClassShift = 30;
+	constexpr size_t ClassCount = MaxClassShift - MinClassShift + 1;
+
+	// The smallest class whose buffers can hold size bytes, or ClassCount if there is none.
+	size_t SizeClass(size_t size)
+	{
+		auto sizeClass = size_t(0);
+		while (sizeClass < ClassCount && (size_t(1) << (sizeClass + MinClassShift)) < size)
+			sizeClass++;
+		return sizeClass;
+	}
+}
+
+struct BufferPool::State
+{
+	std::mutex mutex;
+	std::array<std::vector<std::unique_ptr<std::vector<uint8_t>>>, ClassCount> freeLists;
+	size_t cachedBytes = 0;
+	size_t maxCachedBytes;
+};
+
+BufferPool::BufferPool(size_t maxCachedBytes)
+	: m_state(std::make_shared<State>())
+{
+	m_state->maxCachedBytes = maxCachedBytes;
+}
+
+BufferPool::Buffer BufferPool::Acquire(size_t size)
+{
+	const auto sizeClass = SizeClass(size);
+
+	std::unique_ptr<std::vector<uint8_t>> buffer;
+	if (sizeClass < ClassCount)
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		auto &freeList = m_state->freeLists[sizeClass];
+		if (!freeList.empty())
+		{
+			buffer = std::move(freeList.back());
+			freeList.pop_back();
+			m_state->cachedBytes -= buffer->capacity();
+		}
+	}
+
+	if (buffer == nullptr)
+	{
+		buffer = std::make_unique<std::vector<uint8_t>>();
+		if (sizeClass < ClassCount)
+			buffer->reserve(size_t(1) << (sizeClass + MinClassShift));
+	}
+
+	// Within the reserved capacity, so this never reallocates.
+	buffer->resize(size);
+	return Buffer(buffer.release(), Recycler(m_state));
+}
+
+void BufferPool::Trim()
+{
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	for (auto &freeList : m_state->freeLists)
+		freeList.clear();
+	m_state->cachedBytes = 0;
+}
+
+size_t BufferPool::GetCachedBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	return m_state->cachedBytes;
+}
+
+void BufferPool::Recycler::operator()(std::vector<uint8_t> *buffer) const
+{
+	std::unique_ptr<std::vector<uint8_t>> owned(buffer);
+	if (m_state == nullptr || owned == nullptr)
+		return;
+
+	// Only buffers that still fill a whole class are reused; the class is capacity rounded down.
+	const auto capacity = owned->capacity();
+	auto sizeClass = SizeClass(capacity);
+	if (sizeClass < ClassCount && (size_t(1) << (sizeClass + MinClassShift)) > capacity)
+	{
+		if (sizeClass == 0)
+			return;
+		sizeClass--;
+	}
+	if (sizeClass >= ClassCount)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	if (m_state->cachedBytes + capacity > m_state->maxCachedBytes)
+		return;
+
+	m_state->cachedBytes += capacity;
+	m_state->freeLists[sizeClass].push_back(std::move(owned));
+}
@@ -1,5 +1,4 @@
 #include <libbndl/bundle.hpp>
-#include <binaryio/binaryreader.hpp>
 #include <binaryio/binarywriter.hpp>
 #include <fstream>
 #include <cassert>
@@ -9,20 +8,72 @@
 #include <regex>
 #include <iomanip>
 #include <array>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <unordered_set>
+#include <chrono>
+#include "endian.hpp"
+#include "trace_span.hpp"
+#include "parallel.hpp"
+#include "xxh64.hpp"
 
 using namespace libbndl;
 
+constexpr auto BND2HeaderSize = 0x30U;
+constexpr auto BND2IDEntrySize = 0x40U;
+constexpr auto DependencySize = 0x10U;
+constexpr auto ResourceStringTableID = 0xC039284AU; // BNDL stores the table as a resource
+
+namespace
+{
+	// Adds the time until it goes out of scope to a statistics counter.
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(std::atomic<uint64_t> &nanoseconds)
+			: m_nanoseconds(nanoseconds), m_start(std::chrono::steady_clock::now())
+		{
+		}
+
+		~ScopedTimer()
+		{
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+			m_nanoseconds.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<uint64_t> &m_nanoseconds;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	void Add(std::atomic<uint64_t> &counter, uint64_t value)
+	{
+		counter.fetch_add(value, std::memory_order_relaxed);
+	}
+}
+
+// Rounds offset up to a multiple of alignment, a power of two.
+inline uint64_t AlignOffset(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
 #ifndef __has_builtin
 #	define __has_builtin(x) 0
 #endif
-inline unsigned long BitScanReverse(unsigned long input)
+inline unsigned long BitScanReverse(uint32_t input)
 {
 	unsigned long result;
 
+	// Alignments are never 0, but empty blocks may not have one.
+	if (input == 0)
+		return 0;
+
 #if defined(_MSC_VER)
 	_BitScanReverse(&result, input);
-#elif __has_builtin(__builtin_clzl) || defined(__GNUC__)
-	result = static_cast<unsigned long>(31 - __builtin_clzl(input));
+#elif __has_builtin(__builtin_clz) || defined(__GNUC__)
+	result = static_cast<unsigned long>(31 - __builtin_clz(input));
 #else
 #	error "Unsupported compiler."
 #endif
@@ -38,321 +89,494 @@ Bundle::Bundle(MagicVersion magicVersion, uint32_t revisionNumber, Platform plat
 	m_flags = flags;
 }
 
-bool Bundle::Load(const std::string &name)
+Bundle::Bundle(Bundle &&other) : Bundle()
+{
+	Swap(other);
+}
+
+Bundle &Bundle::operator=(Bundle &&other)
+{
+	Bundle moved(std::move(other));
+	Swap(moved);
+	return *this;
+}
+
+// Moves go through a swap with a new bundle, so the source is left with its own locks and counters.
+void Bundle::Swap(Bundle &other)
+{
+	using std::swap;
+	swap(m_entries, other.m_entries);
+	swap(m_entriesByType, other.m_entriesByType);
+	swap(m_bufferPool, other.m_bufferPool);
+	swap(m_deferredCompression, other.m_deferredCompression);
+	swap(m_sync, other.m_sync);
+	swap(m_getBinaryCalls, other.m_getBinaryCalls);
+	swap(m_statisticsCallback, other.m_statisticsCallback);
+	swap(m_contentHashes, other.m_contentHashes);
+	swap(m_dataLayout, other.m_dataLayout);
+	swap(m_accessTrace, other.m_accessTrace);
+	swap(m_accessTraced, other.m_accessTraced);
+	swap(m_dependencies, other.m_dependencies);
+	swap(m_dependents, other.m_dependents);
+	swap(m_dependentsValid, other.m_dependentsValid);
+	swap(m_debugInfoEntries, other.m_debugInfoEntries);
+	swap(m_debugStrings, other.m_debugStrings);
+	swap(m_resourceStringTable, other.m_resourceStringTable);
+	swap(m_magicVersion, other.m_magicVersion);
+	swap(m_revisionNumber, other.m_revisionNumber);
+	swap(m_platform, other.m_platform);
+	swap(m_flags, other.m_flags);
+}
+
+// State while loading: the start of the file with all the metadata, and the payload reads that
+// are queued while parsing it, so filtered out data is never read.
+struct Bundle::LoadContext
 {
+	struct PendingRead
+	{
+		uint64_t offset;
+		std::vector<uint8_t> *target;
+	};
+
 	std::ifstream stream;
+	uint64_t fileSize = 0;
+	std::vector<uint8_t> buffer;
+	std::vector<PendingRead> reads;
+	const LoadOptions &options;
+	uint64_t bytesRead = 0;
+	uint64_t bytesAllocated = 0;
+
+	explicit LoadContext(const LoadOptions &loadOptions)
+		: options(loadOptions)
+	{
+	}
+
+	// Makes sure the first size bytes of the file are in buffer.
+	bool Require(uint64_t size)
+	{
+		if (size > fileSize)
+			return false;
+		if (size <= buffer.size())
+			return true;
+
+		const auto readStart = buffer.size();
+		buffer.resize(static_cast<size_t>(size));
+		stream.seekg(readStart, std::ios::beg);
+		stream.read(reinterpret_cast<char *>(buffer.data() + readStart), static_cast<std::streamsize>(size - readStart));
+		bytesRead += size - readStart;
+		return !stream.fail();
+	}
+
+	// Reads a range outside the metadata straight away.
+	bool Read(uint64_t offset, uint64_t size, std::vector<uint8_t> &out)
+	{
+		if (offset > fileSize || size > fileSize - offset)
+			return false;
+
+		out.resize(static_cast<size_t>(size));
+		stream.seekg(offset, std::ios::beg);
+		stream.read(reinterpret_cast<char *>(out.data()), static_cast<std::streamsize>(size));
+		bytesRead += size;
+		bytesAllocated += size;
+		return !stream.fail();
+	}
+
+	bool Wants(uint32_t resourceID, ResourceType resourceType, int block) const
+	{
+		if (resourceID == ResourceStringTableID)
+			return true;
+		if (!options.fileBlocks[block])
+			return false;
+
+		const auto listed = std::find(options.resourceTypes.begin(), options.resourceTypes.end(), resourceType) != options.resourceTypes.end();
+		return listed != options.denyResourceTypes;
+	}
+
+	bool Queue(EntryFileBlockData &dataInfo, uint64_t offset, uint32_t size)
+	{
+		if (offset > fileSize || size > fileSize - offset)
+			return false;
+
+		dataInfo.data = std::make_unique<std::vector<uint8_t>>(size);
+		bytesAllocated += size;
+		reads.push_back({ offset, dataInfo.data.get() });
+		return true;
+	}
+
+	// Reads the queued payloads in file order.
+	bool Finish()
+	{
+		std::sort(reads.begin(), reads.end(), [](const PendingRead &a, const PendingRead &b) { return a.offset < b.offset; });
+		for (const auto &read : reads)
+		{
+			const auto size = read.target->size();
+			if (read.offset + size <= buffer.size())
+			{
+				std::memcpy(read.target->data(), buffer.data() + read.offset, size);
+				continue;
+			}
+
+			stream.seekg(read.offset, std::ios::beg);
+			stream.read(reinterpret_cast<char *>(read.target->data()), static_cast<std::streamsize>(size));
+			if (stream.fail())
+				return false;
+			bytesRead += size;
+		}
+		return true;
+	}
+};
+
+bool Bundle::Load(const std::string &name)
+{
+	return Load(name, LoadOptions());
+}
+
+bool Bundle::Load(const std::string &name, const LoadOptions &options)
+{
+	trace::Span span("Load");
+	LoadContext context(options);
+
+	m_contentHashes.clear();
 
-	stream.open(name, std::ios::in | std::ios::binary | std::ios::ate);
+	trace::Span headerSpan("Read header");
+	context.stream.open(name, std::ios::in | std::ios::binary | std::ios::ate);
 
 	// Check if archive exists
-	if (stream.fail())
+	if (context.stream.fail())
 		return false;
 
-	const auto fileSize = stream.tellg();
-	if (fileSize < 4)
+	context.fileSize = static_cast<uint64_t>(context.stream.tellg());
+	if (!context.Require(4))
 		return false;
 
-	stream.seekg(0, std::ios::beg);
-	const auto &buffer = std::make_shared<std::vector<uint8_t>>(fileSize);
-	stream.read(reinterpret_cast<char *>(buffer->data()), fileSize);
-	stream.close();
-	auto reader = binaryio::BinaryReader(buffer);
+	const auto &buffer = context.buffer;
 
 	// Check if it's a BNDL archive
-	auto magic = reader.ReadString(4);
-	if (magic == std::string("bndl"))
+	if (std::memcmp(buffer.data(), "bndl", 4) == 0)
 		m_magicVersion = BNDL;
-	else if (magic == std::string("bnd2"))
+	else if (std::memcmp(buffer.data(), "bnd2", 4) == 0)
 		m_magicVersion = BND2;
 	else
 		return false;
 
-	return (m_magicVersion == BNDL) ? LoadBNDL(reader): LoadBND2(reader);
+	// The platform is always stored little endian and decides the byte order of everything else.
+	m_platform = static_cast<Platform>(0);
+	if (m_magicVersion == BND2)
+	{
+		if (!context.Require(BND2HeaderSize))
+			return false;
+		m_platform = endian::Load<false, Platform>(buffer.data() + 8);
+	}
+	else
+	{
+		for (const auto offset : { 0x4C, 0x58, 0x64 })
+		{
+			if (!context.Require(offset + sizeof(Platform)))
+				break;
+
+			const auto platform = endian::Load<false, Platform>(buffer.data() + offset);
+			if (platform == PC || platform == Xbox360 || platform == PS3)
+			{
+				m_platform = platform;
+				break;
+			}
+		}
+		if (m_platform == 0)
+			return false;
+	}
+
+	headerSpan.End();
+
+	bool loaded;
+	if (m_magicVersion == BNDL)
+		loaded = (m_platform != PC) ? LoadBNDL<true>(context) : LoadBNDL<false>(context);
+	else
+		loaded = (m_platform != PC) ? LoadBND2<true>(context) : LoadBND2<false>(context);
+
+	if (loaded)
+	{
+		trace::Span dataSpan("Read data");
+		loaded = context.Finish();
+	}
+
+	RebuildTypeIndex();
+
+	Add(m_sync->statistics.bytesRead, context.bytesRead);
+	Add(m_sync->statistics.bytesAllocated, context.bytesAllocated);
+	ReportStatistics();
+
+	return loaded;
 }
 
-bool Bundle::LoadBND2(binaryio::BinaryReader &reader)
+template <bool BigEndian>
+bool Bundle::LoadBND2(LoadContext &context)
 {
-	m_revisionNumber = reader.Read<uint32_t>();
+	trace::Span span("LoadBND2");
+	const auto &buffer = context.buffer;
+	auto header = buffer.data() + 4;
 
-	m_platform = reader.Read<Platform>();
-	reader.SetBigEndian(m_platform != PC);
-
-	if (reader.IsBigEndian())
-		m_revisionNumber = (m_revisionNumber << 24) | (m_revisionNumber << 8 & 0xff0000) | (m_revisionNumber >> 8 & 0xff00) | (m_revisionNumber >> 24);
+	m_revisionNumber = endian::Read<BigEndian, uint32_t>(header);
 	// Little sanity check.
 	if (m_revisionNumber != 2)
 		return false;
 
-	const auto rstOffset = reader.Read<uint32_t>();
-	const auto numEntries = reader.Read<uint32_t>();
+	header += sizeof(Platform); // Already read by Load.
+
+	const auto rstOffset = endian::Read<BigEndian, uint32_t>(header);
+	const auto numEntries = endian::Read<BigEndian, uint32_t>(header);
 
-	const auto idBlockOffset = reader.Read<uint32_t>();
+	const auto idBlockOffset = endian::Read<BigEndian, uint32_t>(header);
 	uint32_t fileBlockOffsets[3];
-	fileBlockOffsets[0] = reader.Read<uint32_t>();
-	fileBlockOffsets[1] = reader.Read<uint32_t>();
-	fileBlockOffsets[2] = reader.Read<uint32_t>();
+	fileBlockOffsets[0] = endian::Read<BigEndian, uint32_t>(header);
+	fileBlockOffsets[1] = endian::Read<BigEndian, uint32_t>(header);
+	fileBlockOffsets[2] = endian::Read<BigEndian, uint32_t>(header);
 
-	m_flags = reader.Read<Flags>();
+	m_flags = endian::Read<BigEndian, Flags>(header);
 
 	// Last 8 bytes are padding.
 
+	// The string table isn't sized, so it runs up to whichever section follows it.
+	const auto hasResourceStringTable = (m_flags & HasResourceStringTable) != 0 && rstOffset < context.fileSize;
+	auto rstEnd = context.fileSize;
+	for (const auto offset : { idBlockOffset, fileBlockOffsets[0], fileBlockOffsets[1], fileBlockOffsets[2] })
+	{
+		if (offset > rstOffset)
+			rstEnd = std::min<uint64_t>(rstEnd, offset);
+	}
+
+	// Read the ID block, and the string table too if it sits in front of the data as usual. One
+	// stored after the data is read on its own, so the data in between is never read.
+	const auto dataStart = *std::min_element(fileBlockOffsets, fileBlockOffsets + 3);
+	auto metadataEnd = uint64_t(idBlockOffset) + uint64_t(numEntries) * BND2IDEntrySize;
+	if (hasResourceStringTable && rstOffset < dataStart)
+		metadataEnd = std::max(metadataEnd, rstEnd);
+	trace::Span metadataSpan("Read metadata");
+	if (!context.Require(metadataEnd))
+		return false;
+	metadataSpan.End();
 
 	m_entries.clear();
-	m_debugInfoEntries.clear();
+	ClearDebugInfo();
+	ClearDependencies();
+
+	trace::Span idBlockSpan("Parse ID block");
+
+	// Every field in the ID block is 32-bit (or a pair of them), so swap the whole block in one go.
+	constexpr auto entryWords = BND2IDEntrySize / sizeof(uint32_t);
+	std::vector<uint32_t> idBlock(numEntries * entryWords);
+	endian::LoadArray<BigEndian>(idBlock.data(), buffer.data() + idBlockOffset, idBlock.size());
+
+	// The low half of a 64-bit field is the second word on big endian platforms.
+	constexpr auto low = BigEndian ? 1 : 0;
 
-	reader.Seek(idBlockOffset);
 	for (auto i = 0U; i < numEntries; i++)
 	{
+		const auto words = idBlock.data() + i * entryWords;
+
 		// These are stored in bundle as 64-bit (8-byte), but are really 32-bit.
-		auto resourceID = static_cast<uint32_t>(reader.Read<uint64_t>());
+		const auto resourceID = words[0 + low];
 		assert(resourceID != 0);
 		auto &e = m_entries[resourceID];
-		e.info.checksum = static_cast<uint32_t>(reader.Read<uint64_t>());
-
-		// The uncompressed sizes have a high nibble that varies depending on the resource type.
-		const auto uncompSize0 = reader.Read<uint32_t>();
-		e.fileBlockData[0].uncompressedSize = uncompSize0 & ~(0xFU << 28);
-		e.fileBlockData[0].uncompressedAlignment = 1 << (uncompSize0 >> 28);
-		const auto uncompSize1 = reader.Read<uint32_t>();
-		e.fileBlockData[1].uncompressedSize = uncompSize1 & ~(0xFU << 28);
-		e.fileBlockData[1].uncompressedAlignment = 1 << (uncompSize1 >> 28);
-		const auto uncompSize2 = reader.Read<uint32_t>();
-		e.fileBlockData[2].uncompressedSize = uncompSize2 & ~(0xFU << 28);
-		e.fileBlockData[2].uncompressedAlignment = 1 << (uncompSize2 >> 28);
-
-		e.fileBlockData[0].compressedSize = reader.Read<uint32_t>();
-		e.fileBlockData[1].compressedSize = reader.Read<uint32_t>();
-		e.fileBlockData[2].compressedSize = reader.Read<uint32_t>();
-
-		auto dataReader = reader.Copy();
+		e.info.checksum = words[2 + low];
+		e.info.resourceType = static_cast<ResourceType>(words[14]);
+
 		for (auto j = 0; j < 3; j++)
 		{
-			dataReader.Seek(fileBlockOffsets[j] + reader.Read<uint32_t>()); // Read offset
-
 			auto &dataInfo = e.fileBlockData[j];
 
+			// The uncompressed sizes have a high nibble that varies depending on the resource type.
+			const auto uncompSize = words[4 + j];
+			dataInfo.uncompressedSize = uncompSize & ~(0xFU << 28);
+			dataInfo.uncompressedAlignment = 1 << (uncompSize >> 28);
+			dataInfo.compressedSize = words[7 + j];
+
 			const auto readSize = (m_flags & Compressed) ? dataInfo.compressedSize : dataInfo.uncompressedSize;
-			if (readSize == 0)
+			if (readSize == 0 || !context.Wants(resourceID, e.info.resourceType, j))
 			{
 				dataInfo.data = nullptr;
 				continue;
 			}
 
-			const auto readBuffer = dataReader.Read<uint8_t *>(readSize);
-			dataInfo.data = std::make_unique<std::vector<uint8_t>>(readBuffer, readBuffer + readSize);
-			delete[] readBuffer;
+			if (!context.Queue(dataInfo, uint64_t(fileBlockOffsets[j]) + words[10 + j], readSize))
+				return false;
 		}
 
-		e.info.dependenciesOffset = reader.Read<uint32_t>();
-		e.info.resourceType = reader.Read<ResourceType>();
-		e.info.numberOfDependencies = reader.Read<uint16_t>();
-
-		reader.Seek(2, std::ios::cur); // Padding
+		e.info.dependenciesOffset = words[13];
+		// 16-bit count followed by 16 bits of padding.
+		e.info.numberOfDependencies = static_cast<uint16_t>(BigEndian ? (words[15] >> 16) : (words[15] & 0xFFFF));
 	}
 
-	if (m_flags & HasResourceStringTable)
-	{
-		reader.Seek(rstOffset, std::ios::beg);
+	idBlockSpan.End();
 
-		const auto rstXML = reader.ReadString();
+	// The dependency tables sit at the end of each block 0, so only read them when first needed.
+	m_sync->dependenciesPending = true;
 
-		pugi::xml_document doc;
-		if (doc.load_string(rstXML.c_str(), pugi::parse_minimal))
+	// The string table is only parsed once debug info is first asked for.
+	if (hasResourceStringTable)
+	{
+		trace::Span rstSpan("Copy resource string table");
+		std::vector<uint8_t> rstRead;
+		auto rstStart = buffer.data() + rstOffset;
+		if (rstEnd > buffer.size())
 		{
-			for (const auto resource : doc.child("ResourceStringTable").children("Resource"))
-			{
-				const auto resourceID = std::stoul(resource.attribute("id").value(), nullptr, 16);
-				auto &debugInfo = m_debugInfoEntries[resourceID];
-				debugInfo.name = resource.attribute("name").value();
-				debugInfo.typeName = resource.attribute("type").value();
-			}
+			if (!context.Read(rstOffset, rstEnd - rstOffset, rstRead))
+				return false;
+			rstStart = rstRead.data();
 		}
+		const auto rstLength = strnlen(reinterpret_cast<const char *>(rstStart), static_cast<size_t>(rstEnd - rstOffset));
+		m_resourceStringTable.data = std::make_unique<std::vector<uint8_t>>(rstStart, rstStart + rstLength);
+		m_resourceStringTable.uncompressedSize = static_cast<uint32_t>(rstLength);
+		m_resourceStringTable.compressedSize = 0;
+		m_sync->debugInfoPending = true;
 	}
 
 	return true;
 }
 
-bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
+template <bool BigEndian>
+bool Bundle::LoadBNDL(LoadContext &context)
 {
-	m_platform = static_cast<Platform>(0);
-	auto platformReader = reader.Copy();
-	for (const auto offset : { 0x4C, 0x58, 0x64 })
-	{
-		platformReader.Seek(offset);
-		const auto platform = platformReader.Read<Platform>();
-		if (platform == PC || platform == Xbox360 || platform == PS3)
-		{
-			m_platform = platform;
-			reader.SetBigEndian(m_platform != PC);
-			break;
-		}
-	}
-	if (m_platform == 0)
-		return false;
-
-	m_revisionNumber = reader.Read<uint32_t>();
-	if (m_revisionNumber < 3 || m_revisionNumber > 5)
-		return false;
-
-	const auto numEntries = reader.Read<uint32_t>();
+	trace::Span span("LoadBNDL");
+	const auto &buffer = context.buffer;
 
 	auto blocks = 4;
 	if (m_platform == Xbox360)
 		blocks = 5;
 	else if (m_platform == PS3)
 		blocks = 6;
+
+	// Revision 5 headers are the largest; older ones are still followed by the ID list.
+	if (!context.Require(0x2CU + blocks * 0xC))
+		return false;
+
+	auto header = buffer.data() + 4;
+
+	m_revisionNumber = endian::Read<BigEndian, uint32_t>(header);
+	if (m_revisionNumber < 3 || m_revisionNumber > 5)
+		return false;
+
+	const auto numEntries = endian::Read<BigEndian, uint32_t>(header);
+
 	uint32_t dataBlockSizes[6];
 	for (auto i = 0; i < blocks; i++)
 	{
-		dataBlockSizes[i] = reader.Read<uint32_t>();
-		reader.Skip<uint32_t>(); // Alignment
+		dataBlockSizes[i] = endian::Read<BigEndian, uint32_t>(header);
+		header += sizeof(uint32_t); // Alignment
 	}
 
-	reader.Seek(0x4 * blocks, std::ios::cur); // memory address stuff
+	header += 0x4 * blocks; // memory address stuff
 
-	const auto idListOffset = reader.Read<uint32_t>();
-	const auto idTableOffset = reader.Read<uint32_t>();
-	reader.Skip<uint32_t>(); // dependency block
-	reader.Skip<uint32_t>(); // start of data block
+	const auto idListOffset = endian::Read<BigEndian, uint32_t>(header);
+	const auto idTableOffset = endian::Read<BigEndian, uint32_t>(header);
+	const auto importBlockOffset = endian::Read<BigEndian, uint32_t>(header);
+	const auto dataStart = endian::Read<BigEndian, uint32_t>(header);
 
-	reader.SetBigEndian(false);
-	reader.Verify<uint32_t>(m_platform);
-	reader.SetBigEndian(m_platform != PC);
+	if (endian::Read<false, Platform>(header) != m_platform)
+		return false;
 
 	auto compressed = 0U;
 	auto uncompInfoOffset = 0U;
 
+	m_flags = static_cast<Flags>(0);
 	if (m_revisionNumber >= 4)
 	{
-		compressed = reader.Read<uint32_t>();
+		compressed = endian::Read<BigEndian, uint32_t>(header);
 		if (compressed)
 			m_flags = Compressed; // TODO
-		else
-			m_flags = static_cast<Flags>(0);
 
-		reader.Skip<uint32_t>(); // number of compressed resources
-		uncompInfoOffset = reader.Read<uint32_t>();
+		header += sizeof(uint32_t); // number of compressed resources
+		uncompInfoOffset = endian::Read<BigEndian, uint32_t>(header);
 	}
 
-	if (m_revisionNumber >= 5)
-	{
-		reader.Skip<uint32_t>(); // main memory alignment
-		reader.Skip<uint32_t>(); // graphics memory alignment
-	}
+	// Revision 5 adds main and graphics memory alignments, which we don't use.
+
+	// All tables normally precede the data, so only read up to there.
+	const auto tablesFirst = idListOffset < dataStart && idTableOffset < dataStart && importBlockOffset <= dataStart
+		&& (!compressed || uncompInfoOffset < dataStart);
+	trace::Span tablesSpan("Read metadata");
+	if (!context.Require(tablesFirst ? dataStart : context.fileSize))
+		return false;
+	tablesSpan.End();
+
+	// Per entry: unknown mem stuff, imports offset, type, then size/alignment, offset/1 and memory address per block.
+	const auto entryWords = 3 + blocks * 5;
+	const auto uncompInfoWords = blocks * 2;
+	if (idListOffset > buffer.size() || numEntries > (buffer.size() - idListOffset) / sizeof(uint64_t)
+		|| idTableOffset > buffer.size() || numEntries > (buffer.size() - idTableOffset) / (entryWords * sizeof(uint32_t))
+		|| (compressed && (uncompInfoOffset > buffer.size() || numEntries > (buffer.size() - uncompInfoOffset) / (uncompInfoWords * sizeof(uint32_t)))))
+		return false;
 
 	m_entries.clear();
-	m_debugInfoEntries.clear();
-	m_dependencies.clear();
+	ClearDebugInfo();
+	ClearDependencies();
 
-	reader.Seek(idListOffset);
-	std::vector<uint32_t> resourceIDs;
-	for (auto i = 0U; i < numEntries; i++)
-		resourceIDs.push_back(static_cast<uint32_t>(reader.Read<uint64_t>()));
+	trace::Span idTableSpan("Parse ID table");
 
-	reader.Seek(idTableOffset);
-	for (const auto resourceID : resourceIDs)
+	std::vector<uint32_t> resourceIDs(numEntries);
+	auto idList = buffer.data() + idListOffset;
+	for (auto &resourceID : resourceIDs)
+		resourceID = static_cast<uint32_t>(endian::Read<BigEndian, uint64_t>(idList));
+
+	std::vector<uint32_t> idTable(numEntries * entryWords);
+	endian::LoadArray<BigEndian>(idTable.data(), buffer.data() + idTableOffset, idTable.size());
+
+	std::vector<uint32_t> uncompInfo;
+	if (compressed)
 	{
-		auto &e = m_entries[resourceID];
+		uncompInfo.resize(numEntries * uncompInfoWords);
+		endian::LoadArray<BigEndian>(uncompInfo.data(), buffer.data() + uncompInfoOffset, uncompInfo.size());
+	}
 
-		reader.Skip<uint32_t>(); // unknown mem stuff
-		e.info.dependenciesOffset = reader.Read<uint32_t>();
-		e.info.resourceType = reader.Read<ResourceType>();
+	for (auto i = 0U; i < numEntries; i++)
+	{
+		auto &e = m_entries[resourceIDs[i]];
 
-		if (compressed)
-		{
-			for (auto j = 0; j < blocks; j++)
-			{
-				auto mappedBlock = MapBNDLBlockToBND2(j);
-				if (mappedBlock == -1)
-				{
-					reader.Verify<uint32_t>(0); // size
-					reader.Verify<uint32_t>(1); // alignment
-				}
-				else
-				{
-					e.fileBlockData[mappedBlock].compressedSize = reader.Read<uint32_t>();
-					reader.Skip<uint32_t>(); // alignment
-				}
-			}
-		}
-		else
-		{
-			for (auto j = 0; j < blocks; j++)
-			{
-				auto mappedBlock = MapBNDLBlockToBND2(j);
-				if (mappedBlock == -1)
-				{
-					reader.Verify<uint32_t>(0); // size
-					reader.Verify<uint32_t>(1); // alignment
-				}
-				else
-				{
-					e.fileBlockData[mappedBlock].uncompressedSize = reader.Read<uint32_t>();
-					e.fileBlockData[mappedBlock].uncompressedAlignment = reader.Read<uint32_t>();
-				}
-			}
-		}
+		const auto words = idTable.data() + i * entryWords;
+		// words[0] is unknown mem stuff
+		e.info.dependenciesOffset = words[1];
+		e.info.resourceType = static_cast<ResourceType>(words[2]);
+
+		const auto sizes = words + 3;
+		const auto offsets = sizes + blocks * 2;
+		const auto uncompSizes = compressed ? uncompInfo.data() + i * uncompInfoWords : sizes;
 
-		auto dataReader = reader.Copy();
-		auto dataBlockStartOffset = 0;
+		auto dataBlockStartOffset = size_t(0);
 		for (auto j = 0; j < blocks; j++)
 		{
 			if (j > 0)
 				dataBlockStartOffset += dataBlockSizes[j - 1];
 
-			const auto readOffset = reader.Read<uint32_t>() + dataBlockStartOffset;
-			reader.Skip<uint32_t>(); // 1
-
 			auto mappedBlock = MapBNDLBlockToBND2(j);
 			if (mappedBlock == -1)
 			{
+				// size 0, alignment 1
+				if (sizes[j * 2] != 0 || sizes[j * 2 + 1] != 1 || uncompSizes[j * 2] != 0 || uncompSizes[j * 2 + 1] != 1)
+					return false;
 				assert(dataBlockSizes[j] == 0);
 				continue;
 			}
 
 			auto &dataInfo = e.fileBlockData[mappedBlock];
+			if (compressed)
+				dataInfo.compressedSize = sizes[j * 2];
+			dataInfo.uncompressedSize = uncompSizes[j * 2];
+			dataInfo.uncompressedAlignment = uncompSizes[j * 2 + 1];
 
 			const auto readSize = compressed ? dataInfo.compressedSize : dataInfo.uncompressedSize;
-			if (readSize == 0)
+			if (readSize == 0 || !context.Wants(resourceIDs[i], e.info.resourceType, mappedBlock))
 			{
 				dataInfo.data = nullptr;
 				continue;
 			}
 
-			dataReader.Seek(readOffset); // Read offset
-
-			const auto readBuffer = dataReader.Read<uint8_t *>(readSize);
-			dataInfo.data = std::make_unique<std::vector<uint8_t>>(readBuffer, readBuffer + readSize);
-			delete[] readBuffer;
+			if (!context.Queue(dataInfo, offsets[j * 2] + dataBlockStartOffset, readSize))
+				return false;
 		}
-
-		reader.Seek(0x4 * blocks, std::ios::cur); // memory address stuff
 	}
 
-	if (compressed)
-	{
-		reader.Seek(uncompInfoOffset);
-		for (const auto resourceID : resourceIDs)
-		{
-			auto &e = m_entries[resourceID];
-
-			for (auto j = 0; j < blocks; j++)
-			{
-				auto mappedBlock = MapBNDLBlockToBND2(j);
-				if (mappedBlock == -1)
-				{
-					reader.Verify<uint32_t>(0); // size
-					reader.Verify<uint32_t>(1); // alignment
-				}
-				else
-				{
-					e.fileBlockData[mappedBlock].uncompressedSize = reader.Read<uint32_t>();
-					e.fileBlockData[mappedBlock].uncompressedAlignment = reader.Read<uint32_t>();
-				}
-			}
-		}
-	}
+	idTableSpan.End();
 
+	trace::Span importsSpan("Parse imports");
 	for (const auto resourceID : resourceIDs)
 	{
 		auto &e = m_entries[resourceID];
@@ -360,109 +584,337 @@ bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
 		if (depOffset == 0)
 			continue;
 
-		reader.Seek(depOffset);
-		e.info.numberOfDependencies = static_cast<uint16_t>(reader.Read<uint32_t>());
-		reader.Verify<uint32_t>(0);
-		for (auto i = 0U; i < e.info.numberOfDependencies; i++)
-			m_dependencies[resourceID].emplace_back(ReadDependency(reader));
-	}
+		if (depOffset > buffer.size() || buffer.size() - depOffset < 8)
+			return false;
 
-	auto rstFile = GetBinary(0xC039284A, 0);
-	if (rstFile == nullptr)
-		return true;
+		auto depHeader = buffer.data() + depOffset;
+		const auto numDependencies = endian::Read<BigEndian, uint32_t>(depHeader);
+		if (endian::Read<BigEndian, uint32_t>(depHeader) != 0
+			|| numDependencies > std::numeric_limits<uint16_t>::max()
+			|| numDependencies > (buffer.size() - depOffset - 8) / DependencySize)
+			return false;
 
-	m_flags = static_cast<Flags>(m_flags | HasResourceStringTable);
+		e.info.numberOfDependencies = static_cast<uint16_t>(numDependencies);
+		ReadDependencies<BigEndian>(depHeader, numDependencies, m_dependencies[resourceID]);
+	}
 
-	auto rstReader = binaryio::BinaryReader(std::move(rstFile));
+	importsSpan.End();
 
-	const auto strLen = rstReader.Read<uint32_t>();
-	auto rstXML = rstReader.ReadString(strLen);
+	const auto rstEntry = m_entries.find(ResourceStringTableID);
+	if (rstEntry == m_entries.end())
+		return true;
 
-	// Cover Criterion's broken XML writer.
-	if (rstXML.rfind("</ResourceStringTable>", 0) == 0)
-		rstXML.erase(1, 1);
-	const auto pos = rstXML.find("</ResourceStringTable>\n\t");
-	if (pos != std::string::npos)
-		rstXML.erase(pos, 23);
+	m_flags = static_cast<Flags>(m_flags | HasResourceStringTable);
 
-	pugi::xml_document doc;
-	if (doc.load_string(rstXML.c_str(), pugi::parse_minimal))
+	// Keep the stored (possibly compressed) block around until debug info is first asked for.
+	if (rstEntry->second.fileBlockData[0].data != nullptr)
 	{
-		for (const auto resource : doc.child("ResourceStringTable").children("Resource"))
-		{
-			const auto resourceID = std::stoul(resource.attribute("id").value(), nullptr, 16);
-			auto &debugInfo = m_debugInfoEntries[resourceID];
-			debugInfo.name = resource.attribute("name").value();
-			debugInfo.typeName = resource.attribute("type").value();
-		}
+		m_resourceStringTable = std::move(rstEntry->second.fileBlockData[0]);
+		m_sync->debugInfoPending = true;
 	}
 
-	m_entries.erase(0xC039284A);
+	m_entries.erase(rstEntry);
 
 	return true;
 }
 
-int8_t Bundle::MapBNDLBlockToBND2(uint8_t block) const
+void Bundle::LoadDebugInfo() const
 {
-	auto mappedBlock = block;
-	switch (m_platform)
-	{
-	case PC:
-		if (block >= 3)
-			mappedBlock = -1;
-		break;
-	case Xbox360:
-		if (block == 1 || block >= 4)
-			mappedBlock = -1;
-		else if (block != 0)
-			mappedBlock = block - 1;
-		break;
-	case PS3:
-		if ((block >= 1 && block <= 3) || block >= 6)
-			mappedBlock = -1;
-		else if (block != 0)
-			mappedBlock = block - 3;
-		break;
-	default:
-		mappedBlock = -1;
-		break;
-	}
-	return mappedBlock;
-}
+	if (!m_sync->debugInfoPending.load(std::memory_order_acquire))
+		return;
 
-bool Bundle::Save(const std::string &name)
-{
-	auto writer = binaryio::BinaryWriter();
+	std::lock_guard<std::mutex> lock(m_sync->debugInfoMutex);
+	if (!m_sync->debugInfoPending.load(std::memory_order_relaxed))
+		return;
 
-	switch (m_magicVersion)
+	trace::Span span("Parse resource string table");
+	const auto rstFile = DecompressBlock(m_resourceStringTable);
+	if (rstFile != nullptr)
 	{
-	case BNDL:
-		if (!SaveBNDL(writer))
-			return false;
-		break;
-
-	case BND2:
-		if (!SaveBND2(writer))
-			return false;
-		break;
+		auto rstXML = std::string_view(reinterpret_cast<const char *>(rstFile->data()), rstFile->size());
+		if (m_magicVersion == BNDL)
+		{
+			// The length prefix is always written little endian. Too short a block has no debug info.
+			if (rstXML.size() < 4)
+				rstXML = {};
+			else
+				rstXML = rstXML.substr(4, std::min<size_t>(endian::Load<false, uint32_t>(rstFile->data()), rstXML.size() - 4));
+		}
 
-	default:
-		return false;
+		ScopedTimer timer(m_sync->statistics.debugInfoParseNanoseconds);
+		ParseResourceStringTable(rstXML);
 	}
 
-	std::ofstream f(name, std::ios::out | std::ios::binary);
-	f << writer.GetStream().rdbuf();
-	f.close();
-
-	return true;
+	m_resourceStringTable = {};
+	m_sync->debugInfoPending.store(false, std::memory_order_release);
 }
 
-
-bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
+void Bundle::ParseResourceStringTable(std::string_view xml) const
 {
-	writer.Write("bnd2", 4);
-	writer.Write<uint32_t>(2); // Bundle version
-	writer.Write(PC); // Only PC writing supported for now.
+	// A single pass over the <Resource id="" type="" name=""/> elements. Like the pugixml
+	// parse_minimal this replaces, entities are left as is. Matching elements rather than parsing
+	// the document also covers Criterion's broken XML writer.
+	const auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+
+	constexpr auto tag = std::string_view("<Resource");
+	auto pos = xml.find(tag);
+	while (pos != std::string_view::npos)
+	{
+		pos += tag.size();
+		if (pos >= xml.size() || !isSpace(xml[pos]))
+		{
+			pos = xml.find(tag, pos); // e.g. <ResourceStringTable>
+			continue;
+		}
+
+		auto hasID = false;
+		auto resourceID = 0U;
+		std::string_view name;
+		std::string_view typeName;
+
+		while (pos < xml.size() && xml[pos] != '>' && xml[pos] != '/')
+		{
+			if (isSpace(xml[pos]))
+			{
+				pos++;
+				continue;
+			}
+
+			const auto equals = xml.find('=', pos);
+			if (equals == std::string_view::npos)
+				return;
+
+			auto attribute = xml.substr(pos, equals - pos);
+			while (!attribute.empty() && isSpace(attribute.back()))
+				attribute.remove_suffix(1);
+
+			auto quotePos = equals + 1;
+			while (quotePos < xml.size() && isSpace(xml[quotePos]))
+				quotePos++;
+			if (quotePos >= xml.size())
+				return;
+
+			const auto quote = xml[quotePos];
+			const auto valueEnd = xml.find(quote, quotePos + 1);
+			if ((quote != '"' && quote != '\'') || valueEnd == std::string_view::npos)
+				return;
+			const auto value = xml.substr(quotePos + 1, valueEnd - quotePos - 1);
+
+			if (attribute == "id")
+			{
+				// Hex, as written by std::hex, optionally with a 0x prefix.
+				auto digits = value;
+				if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X'))
+					digits.remove_prefix(2);
+
+				hasID = !digits.empty();
+				resourceID = 0;
+				for (const auto c : digits)
+				{
+					uint32_t nibble;
+					if (c >= '0' && c <= '9')
+						nibble = c - '0';
+					else if (c >= 'a' && c <= 'f')
+						nibble = c - 'a' + 10;
+					else if (c >= 'A' && c <= 'F')
+						nibble = c - 'A' + 10;
+					else
+					{
+						hasID = false;
+						break;
+					}
+					resourceID = (resourceID << 4) | nibble;
+				}
+			}
+			else if (attribute == "name")
+			{
+				name = value;
+			}
+			else if (attribute == "type")
+			{
+				typeName = value;
+			}
+
+			pos = valueEnd + 1;
+		}
+
+		if (hasID)
+			m_debugInfoEntries[resourceID] = { m_debugStrings.Intern(name), m_debugStrings.Intern(typeName) };
+
+		pos = xml.find(tag, pos);
+	}
+}
+
+void Bundle::ClearDebugInfo()
+{
+	m_debugInfoEntries.clear();
+	m_debugStrings.Clear();
+	m_resourceStringTable = {};
+	m_sync->debugInfoPending = false;
+}
+
+std::string_view Bundle::StringPool::Intern(std::string_view str)
+{
+	const auto it = m_strings.find(str);
+	if (it != m_strings.end())
+		return *it;
+
+	char *storage;
+	if (str.size() > ChunkSize / 4)
+	{
+		// Long strings get an allocation of their own rather than wasting the rest of a chunk.
+		m_chunks.emplace_back(std::make_unique<char[]>(str.size()));
+		storage = m_chunks.back().get();
+	}
+	else
+	{
+		if (str.size() > m_chunkRemaining)
+		{
+			m_chunks.emplace_back(std::make_unique<char[]>(ChunkSize));
+			m_chunkHead = m_chunks.back().get();
+			m_chunkRemaining = ChunkSize;
+		}
+		storage = m_chunkHead;
+		m_chunkHead += str.size();
+		m_chunkRemaining -= str.size();
+	}
+
+	if (!str.empty())
+		std::memcpy(storage, str.data(), str.size());
+
+	const auto interned = std::string_view(storage, str.size());
+	m_strings.insert(interned);
+	return interned;
+}
+
+void Bundle::StringPool::Clear()
+{
+	m_strings.clear();
+	m_chunks.clear();
+	m_chunkHead = nullptr;
+	m_chunkRemaining = 0;
+}
+
+int8_t Bundle::MapBNDLBlockToBND2(uint8_t block) const
+{
+	auto mappedBlock = block;
+	switch (m_platform)
+	{
+	case PC:
+		if (block >= 3)
+			mappedBlock = -1;
+		break;
+	case Xbox360:
+		if (block == 1 || block >= 4)
+			mappedBlock = -1;
+		else if (block != 0)
+			mappedBlock = block - 1;
+		break;
+	case PS3:
+		if ((block >= 1 && block <= 3) || block >= 6)
+			mappedBlock = -1;
+		else if (block != 0)
+			mappedBlock = block - 3;
+		break;
+	default:
+		mappedBlock = -1;
+		break;
+	}
+	return mappedBlock;
+}
+
+bool Bundle::Save(const std::string &name)
+{
+	trace::Span span("Save");
+
+	// Data filtered out on load can't be written back.
+	for (const auto &entry : m_entries)
+	{
+		for (const auto &dataInfo : entry.second.fileBlockData)
+		{
+			const auto readSize = (m_flags & Compressed) ? dataInfo.compressedSize : dataInfo.uncompressedSize;
+			if (readSize > 0 && dataInfo.data == nullptr)
+				return false;
+		}
+	}
+
+	if (m_flags & Compressed)
+	{
+		trace::Span compressSpan("Compress deferred blocks");
+		if (!CompressDeferredBlocks())
+			return false;
+	}
+
+	auto writer = binaryio::BinaryWriter();
+	SaveLayout layout;
+
+	switch (m_magicVersion)
+	{
+	case BNDL:
+		if (!SaveBNDL(writer, layout))
+			return false;
+		break;
+
+	case BND2:
+		if (!SaveBND2(writer, layout))
+			return false;
+		break;
+
+	default:
+		return false;
+	}
+
+	// Offsets are stored in 32 bits.
+	if (layout.fileSize > std::numeric_limits<uint32_t>::max())
+		return false;
+
+	trace::Span writeSpan("Write file");
+	std::ofstream f(name, std::ios::out | std::ios::binary | std::ios::trunc);
+	const auto tables = writer.GetStream().str();
+	f.write(tables.data(), static_cast<std::streamsize>(tables.size()));
+
+	// Zero padding between blocks.
+	static const char zeros[4096] = {};
+	auto position = uint64_t(tables.size());
+	const auto padTo = [&](uint64_t offset)
+	{
+		while (position < offset)
+		{
+			const auto size = std::min<uint64_t>(offset - position, sizeof(zeros));
+			f.write(zeros, static_cast<std::streamsize>(size));
+			position += size;
+		}
+	};
+
+	for (const auto &write : layout.writes)
+	{
+		if (write.offset < position)
+			return false;
+
+		padTo(write.offset);
+		f.write(reinterpret_cast<const char *>(write.data), static_cast<std::streamsize>(write.size));
+		position += write.size;
+	}
+	padTo(layout.fileSize);
+
+	f.close();
+	if (f.fail())
+		return false;
+	writeSpan.End();
+
+	ReportStatistics();
+
+	return true;
+}
+
+
+bool Bundle::SaveBND2(binaryio::BinaryWriter &writer, SaveLayout &layout)
+{
+	trace::Span span("SaveBND2");
+
+	writer.Write("bnd2", 4);
+	writer.Write<uint32_t>(2); // Bundle version
+	writer.Write(PC); // Only PC writing supported for now.
 
 	auto rstPointerPos = writer.GetOffset();
 	writer.Seek(4, std::ios::cur); // write later
@@ -487,6 +939,10 @@ bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
 	writer.VisitAndWrite<uint32_t>(rstPointerPos, writer.GetOffset());
 	if (m_flags & HasResourceStringTable)
 	{
+		trace::Span rstSpan("Write resource string table");
+
+		LoadDebugInfo();
+
 		pugi::xml_document doc;
 		auto root = doc.append_child("ResourceStringTable");
 		for (const auto &entry : m_debugInfoEntries)
@@ -497,8 +953,8 @@ bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
 			idStream << std::hex << std::setw(8) << std::setfill('0') << entry.first;
 
 			entryChild.append_attribute("id").set_value(idStream.str().c_str());
-			entryChild.append_attribute("type").set_value(entry.second.typeName.c_str());
-			entryChild.append_attribute("name").set_value(entry.second.name.c_str());
+			entryChild.append_attribute("type").set_value(std::string(entry.second.typeName).c_str());
+			entryChild.append_attribute("name").set_value(std::string(entry.second.name).c_str());
 		}
 
 		std::stringstream out;
@@ -511,8 +967,9 @@ bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
 
 
 	// ID BLOCK
+	trace::Span idBlockSpan("Write ID block");
 	writer.VisitAndWrite<uint32_t>(idBlockPointerPos, writer.GetOffset());
-	auto entryDataPointerPos = std::vector<std::array<off_t, 3>>(m_entries.size());
+	auto entryDataPointerPos = std::map<uint32_t, std::array<off_t, 3>>();
 	auto entryIter = m_entries.begin();
 	for (auto i = 0U; i < m_entries.size(); i++)
 	{
@@ -523,12 +980,12 @@ bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
 		writer.Write<uint64_t>(e.info.checksum);
 
 		for (auto &dataInfo : e.fileBlockData)
-			writer.Write(dataInfo.uncompressedSize | (BitScanReverse(dataInfo.uncompressedAlignment) << 28));
+			writer.Write<uint32_t>(dataInfo.uncompressedSize | static_cast<uint32_t>(BitScanReverse(dataInfo.uncompressedAlignment) << 28));
 		for (auto &dataInfo : e.fileBlockData)
 			writer.Write(dataInfo.compressedSize);
 		for (auto j = 0; j < 3; j++)
 		{
-			entryDataPointerPos[i][j] = writer.GetOffset();
+			entryDataPointerPos[entryIter->first][j] = writer.GetOffset();
 			writer.Seek(4, std::ios::cur);
 		}
 
@@ -541,39 +998,43 @@ bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
 		entryIter = std::next(entryIter);
 	}
 
+	idBlockSpan.End();
+
 	// DATA BLOCK
+	const auto order = GetDataLayoutOrder();
+	auto offset = uint64_t(writer.GetOffset());
 	for (auto i = 0; i < 3; i++)
 	{
-		const auto blockStart = writer.GetOffset();
-		writer.VisitAndWrite<uint32_t>(fileBlockPointerPos[i], blockStart);
+		const auto blockStart = offset;
+		writer.VisitAndWrite<uint32_t>(fileBlockPointerPos[i], static_cast<uint32_t>(blockStart));
 
-		entryIter = m_entries.begin();
-		for (auto j = 0U; j < m_entries.size(); j++)
+		for (auto k = 0U; k < order.size(); k++)
 		{
-			const auto &e = entryIter->second;
+			const auto &e = order[k]->second;
 
 			const auto &dataInfo = e.fileBlockData[i];
 			const auto readSize = (m_flags & Compressed) ? dataInfo.compressedSize : dataInfo.uncompressedSize;
 
 			if (readSize > 0)
 			{
-				writer.VisitAndWrite<uint32_t>(entryDataPointerPos[j][i], writer.GetOffset() - blockStart);
-				writer.Write(dataInfo.data->data(), readSize);
-				writer.Align((i != 0 && j != m_entries.size() - 1) ? 0x80 : 16);
+				writer.VisitAndWrite<uint32_t>(entryDataPointerPos.at(order[k]->first)[i], static_cast<uint32_t>(offset - blockStart));
+				layout.writes.push_back({ offset, dataInfo.data->data(), readSize });
+				offset = AlignOffset(offset + readSize, (i != 0 && k != order.size() - 1) ? 0x80 : 16);
 			}
-
-			entryIter = std::next(entryIter);
 		}
 
 		if (i != 2)
-			writer.Align(0x80);
+			offset = AlignOffset(offset, 0x80);
 	}
+	layout.fileSize = offset;
 
 	return true;
 }
 
-bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
+bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer, SaveLayout &layout)
 {
+	trace::Span span("SaveBNDL");
+
 	if (m_revisionNumber <= 3 && (m_flags & Compressed) != 0)
 		return false; // Invalid combination
 
@@ -582,6 +1043,7 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 	writer.Write("bndl", 4);
 	writer.Write<uint32_t>(m_revisionNumber);
 
+	LoadDebugInfo();
 	const bool writeDebugData = !m_debugInfoEntries.empty() && (m_flags & Compressed) == 0; // TODO: is the compressed check accurate?
 	auto entryCount = static_cast<uint32_t>(m_entries.size());
 	if (writeDebugData)
@@ -629,7 +1091,7 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 	{
 		writer.Write<uint32_t>(m_flags & Compressed);
 		writer.Write<uint32_t>((m_flags & Compressed) ? entryCount : 0);
-		auto uncompInfoBlockPointerPos = writer.GetOffset();
+		uncompInfoBlockPointerPos = writer.GetOffset();
 		writer.Write<uint32_t>(0); // will write later, but only if needed
 	}
 
@@ -648,11 +1110,13 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 		writer.Write<uint64_t>(entry.first);
 	}
 	if (writeDebugData)
-		writer.Write<uint64_t>(0xC039284A);
+		writer.Write<uint64_t>(ResourceStringTableID);
 
 	// Prepare ResourceStringTable
 	if (writeDebugData)
 	{
+		trace::Span rstSpan("Write resource string table");
+
 		pugi::xml_document doc;
 		auto root = doc.append_child("ResourceStringTable");
 		for (const auto &entry : m_debugInfoEntries)
@@ -663,8 +1127,8 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 			idStream << std::hex << std::setw(8) << std::setfill('0') << entry.first;
 
 			entryChild.append_attribute("id").set_value(idStream.str().c_str());
-			entryChild.append_attribute("type").set_value(entry.second.typeName.c_str());
-			entryChild.append_attribute("name").set_value(entry.second.name.c_str());
+			entryChild.append_attribute("type").set_value(std::string(entry.second.typeName).c_str());
+			entryChild.append_attribute("name").set_value(std::string(entry.second.name).c_str());
 		}
 
 		std::stringstream out;
@@ -677,7 +1141,7 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 
 		const auto data = debugDataWriter.GetStream().str();
 
-		auto &e = m_entries[0xFFFFFFFF]; // HACK
+		auto &e = m_entries[0xFFFFFFFF]; // HACK: sorts last, matching the ResourceStringTableID written above
 		e.info.resourceType = TextFile;
 		e.fileBlockData[0].data = std::make_unique<std::vector<uint8_t>>(data.begin(), data.end());
 		e.fileBlockData[0].uncompressedSize = static_cast<uint32_t>(data.size());
@@ -685,6 +1149,7 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 	}
 
 	// ID TABLE
+	trace::Span tablesSpan("Write tables");
 	writer.VisitAndWrite<uint32_t>(idTablePointerPos, writer.GetOffset());
 
 	struct FilePointerPosHelper
@@ -776,17 +1241,22 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 		{
 			writer.Write<uint64_t>(import.resourceID);
 			writer.Write<uint32_t>(import.internalOffset);
-			writer.Align(8);
+			writer.Write<uint32_t>(0); // padding; entries are 16 bytes wherever the table starts
 		}
 	}
 
+	tablesSpan.End();
+
 	// DATA
 	writer.VisitAndWrite<uint32_t>(dataBlockPointerPos, writer.GetOffset());
-	off_t blockStartOffset = 0;
+	auto offset = uint64_t(writer.GetOffset());
+	uint64_t blockStartOffset = 0;
+	const auto order = GetDataLayoutOrder();
 	for (auto i = 0; i < 3; i++)
 	{
-		for (const auto &entry : m_entries)
+		for (const auto entryIt : order)
 		{
+			const auto &entry = *entryIt;
 			const auto &e = entry.second;
 
 			const auto &dataInfo = e.fileBlockData[i];
@@ -794,39 +1264,60 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 
 			if (readSize > 0)
 			{
-				writer.VisitAndWrite<uint32_t>(filePointerPosMap.at(entry.first).dataBlockPointerPos[i], writer.GetOffset() - blockStartOffset);
-				writer.Write(dataInfo.data->data(), readSize);
+				writer.VisitAndWrite<uint32_t>(filePointerPosMap.at(entry.first).dataBlockPointerPos[i], static_cast<uint32_t>(offset - blockStartOffset));
+				layout.writes.push_back({ offset, dataInfo.data->data(), readSize });
+				offset += readSize;
 			}
 		}
 
-		const auto size = writer.GetOffset() - blockStartOffset;
-		writer.VisitAndWrite<uint32_t>(dataBlockDescriptorsPos[i], size);
-		writer.VisitAndWrite<uint32_t>(dataBlockDescriptorsPos[i], (size == 0) ? 1 : ((i >= 1) ? 4096 : 1024)); // TODO: This changes and I don't know the pattern.
-		blockStartOffset = writer.GetOffset();
+		const auto size = offset - blockStartOffset;
+		writer.VisitAndWrite<uint32_t>(dataBlockDescriptorsPos[i], static_cast<uint32_t>(size));
+		writer.VisitAndWrite<uint32_t>(dataBlockDescriptorsPos[i] + 4, (size == 0) ? 1 : ((i >= 1) ? 4096 : 1024)); // TODO: This changes and I don't know the pattern.
+		blockStartOffset = offset;
 	}
+	layout.fileSize = offset;
 
+	// The string table is written after this returns, so the layout keeps its data.
+	if (writeDebugData)
+		layout.buffers.push_back(std::move(m_entries[0xFFFFFFFF].fileBlockData[0].data));
 	m_entries.erase(0xFFFFFFFF);
 
 	return true;
 }
 
-uint32_t Bundle::HashResourceName(std::string resourceName) const
+uint32_t Bundle::HashResourceName(std::string_view resourceName)
 {
-	std::transform(resourceName.begin(), resourceName.end(), resourceName.begin(), tolower);
-	return crc32_z(0, reinterpret_cast<const Bytef *>(resourceName.c_str()), resourceName.length());
+	// Lowercase into a stack buffer a chunk at a time. The branch-free form vectorizes.
+	std::array<uint8_t, 256> lowered;
+	uLong crc = 0;
+	while (!resourceName.empty())
+	{
+		const auto chunkSize = std::min(resourceName.size(), lowered.size());
+		for (auto i = 0U; i < chunkSize; i++)
+		{
+			const auto c = static_cast<uint8_t>(resourceName[i]);
+			lowered[i] = c + ((static_cast<uint8_t>(c - 'A') < 26) << 5);
+		}
+		crc = crc32_z(crc, lowered.data(), chunkSize);
+		resourceName.remove_prefix(chunkSize);
+	}
+	return static_cast<uint32_t>(crc);
 }
 
-Bundle::Dependency Bundle::ReadDependency(binaryio::BinaryReader &reader)
+template <bool BigEndian>
+void Bundle::ReadDependencies(const uint8_t *data, uint32_t count, std::vector<Dependency> &dependencies)
 {
-	const Dependency &dep = {
-		static_cast<uint32_t>(reader.Read<uint64_t>()),
-		reader.Read<uint32_t>()
-	};
-	reader.Skip<uint32_t>();
-	return dep;
+	dependencies.reserve(dependencies.size() + count);
+	for (auto i = 0U; i < count; i++, data += DependencySize)
+	{
+		dependencies.push_back({
+			static_cast<uint32_t>(endian::Load<BigEndian, uint64_t>(data)),
+			endian::Load<BigEndian, uint32_t>(data + 8)
+		});
+	}
 }
 
-std::optional<Bundle::EntryData> Bundle::GetData(const std::string &resourceName) const
+std::optional<Bundle::EntryData> Bundle::GetData(std::string_view resourceName) const
 {
 	return GetData(HashResourceName(resourceName));
 }
@@ -853,217 +1344,1284 @@ std::optional<Bundle::EntryData> Bundle::GetData(uint32_t resourceID) const
 		}
 		else
 		{
-			const auto buffer = std::make_shared<std::vector<uint8_t>>(data.fileBlockData[0]->begin() + it->second.info.dependenciesOffset, data.fileBlockData[0]->end());
-			binaryio::BinaryReader reader(buffer, m_platform != PC);
-			for (auto i = 0U; i < numDependencies; i++)
-				data.dependencies.emplace_back(ReadDependency(reader));
-			data.fileBlockData[0]->resize(data.fileBlockData[0]->size() - buffer->size());
+			if (data.fileBlockData[0] == nullptr)
+				return {};
+
+			auto &block = *data.fileBlockData[0];
+			const auto depOffset = it->second.info.dependenciesOffset;
+			if (depOffset > block.size() || numDependencies > (block.size() - depOffset) / DependencySize)
+				return {};
+
+			if (m_platform != PC)
+				ReadDependencies<true>(block.data() + depOffset, numDependencies, data.dependencies);
+			else
+				ReadDependencies<false>(block.data() + depOffset, numDependencies, data.dependencies);
+			block.resize(depOffset);
 		}
 	}
 
 	return std::move(data);
 }
 
-std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinary(const std::string &resourceName, uint32_t fileBlock) const
+const std::vector<Bundle::Dependency> &Bundle::GetDependencies(uint32_t resourceID) const
 {
-	return GetBinary(HashResourceName(resourceName), fileBlock);
+	static const std::vector<Dependency> noDependencies;
+
+	LoadDependencies();
+
+	const auto it = m_dependencies.find(resourceID);
+	return (it != m_dependencies.end()) ? it->second : noDependencies;
 }
 
-std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinary(uint32_t resourceID, uint32_t fileBlock) const
+const std::vector<uint32_t> &Bundle::GetDependents(uint32_t resourceID) const
 {
-	const auto it = m_entries.find(resourceID);
-	if (it == m_entries.end())
-		return {};
+	static const std::vector<uint32_t> noDependents;
 
-	const auto &e = it->second;
+	LoadDependencies();
+
+	std::lock_guard<std::mutex> lock(m_sync->dependencyMutex);
+	if (!m_dependentsValid)
+	{
+		m_dependents.clear();
+		for (const auto &entry : m_dependencies)
+		{
+			for (const auto &dependency : entry.second)
+			{
+				auto &dependents = m_dependents[dependency.resourceID];
+				if (dependents.empty() || dependents.back() != entry.first)
+					dependents.push_back(entry.first);
+			}
+		}
+		m_dependentsValid = true;
+	}
 
-	const auto &dataInfo = e.fileBlockData[fileBlock];
+	const auto it = m_dependents.find(resourceID);
+	return (it != m_dependents.end()) ? it->second : noDependents;
+}
 
-	if (dataInfo.data == nullptr)
-		return {};
+std::vector<uint32_t> Bundle::GetTransitiveDependencies(uint32_t resourceID) const
+{
+	LoadDependencies();
 
-	const auto &buffer = dataInfo.data;
-	const auto uncompressedSize = dataInfo.uncompressedSize;
+	// Includes imports from other bundles, but those can't be followed any further.
+	std::vector<uint32_t> result;
+	std::vector<uint32_t> queue = { resourceID };
+	std::unordered_set<uint32_t> visited = { resourceID };
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		const auto it = m_dependencies.find(queue[i]);
+		if (it == m_dependencies.end())
+			continue;
 
-	auto uncompressedBuffer = std::make_unique<std::vector<uint8_t>>(uncompressedSize);
+		for (const auto &dependency : it->second)
+		{
+			// resourceID starts out visited, so a cycle back to it doesn't add it.
+			if (visited.insert(dependency.resourceID).second)
+			{
+				queue.push_back(dependency.resourceID);
+				result.push_back(dependency.resourceID);
+			}
+		}
+	}
 
-	if (dataInfo.compressedSize > 0)
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+std::vector<uint32_t> Bundle::GetLoadOrder() const
+{
+	LoadDependencies();
+
+	// Kahn's algorithm. Only dependencies within this bundle constrain the order; resources in a
+	// cycle are appended in ID order at the end.
+	std::vector<uint32_t> ids;
+	ids.reserve(m_entries.size());
+	for (const auto &entry : m_entries)
+		ids.push_back(entry.first);
+
+	std::vector<uint32_t> remaining(ids.size());
+	std::vector<std::vector<uint32_t>> dependents(ids.size());
+	std::vector<uint32_t> dependencyIndices;
+	for (auto i = 0U; i < ids.size(); i++)
 	{
-		assert(m_flags & Compressed);
+		const auto it = m_dependencies.find(ids[i]);
+		if (it == m_dependencies.end())
+			continue;
 
-		uLongf uncompressedSizeLong = uncompressedSize;
-		const auto ret = uncompress(uncompressedBuffer->data(), &uncompressedSizeLong, buffer->data(), static_cast<uLong>(dataInfo.compressedSize));
+		dependencyIndices.clear();
+		for (const auto &dependency : it->second)
+		{
+			const auto dep = std::lower_bound(ids.begin(), ids.end(), dependency.resourceID);
+			if (dep != ids.end() && *dep == dependency.resourceID && dep - ids.begin() != i)
+				dependencyIndices.push_back(static_cast<uint32_t>(dep - ids.begin()));
+		}
+		std::sort(dependencyIndices.begin(), dependencyIndices.end());
+		dependencyIndices.erase(std::unique(dependencyIndices.begin(), dependencyIndices.end()), dependencyIndices.end());
 
-		assert(ret == Z_OK);
-		assert(uncompressedSize == uncompressedSizeLong);
+		remaining[i] = static_cast<uint32_t>(dependencyIndices.size());
+		for (const auto dep : dependencyIndices)
+			dependents[dep].push_back(i);
 	}
-	else
+
+	std::vector<uint32_t> order;
+	order.reserve(ids.size());
+	for (auto i = 0U; i < ids.size(); i++)
+	{
+		if (remaining[i] == 0)
+			order.push_back(i);
+	}
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		for (const auto dependent : dependents[order[i]])
+		{
+			if (--remaining[dependent] == 0)
+				order.push_back(dependent);
+		}
+	}
+	for (auto i = 0U; i < ids.size(); i++)
 	{
-		std::memcpy(uncompressedBuffer->data(), buffer->data(), uncompressedSize);
+		if (remaining[i] != 0)
+			order.push_back(i);
 	}
 
-	return uncompressedBuffer;
+	for (auto &index : order)
+		index = ids[index];
+	return order;
 }
 
-std::optional<Bundle::EntryDebugInfo> Bundle::GetDebugInfo(const std::string &resourceName) const
+void Bundle::LoadDependencies() const
 {
-	return GetDebugInfo(HashResourceName(resourceName));
+	if (!m_sync->dependenciesPending.load(std::memory_order_acquire))
+		return;
+
+	std::lock_guard<std::mutex> lock(m_sync->dependencyMutex);
+	if (!m_sync->dependenciesPending.load(std::memory_order_relaxed))
+		return;
+
+	std::vector<std::pair<uint32_t, const Entry *>> entries;
+	for (const auto &entry : m_entries)
+	{
+		if (entry.second.info.numberOfDependencies > 0)
+			entries.emplace_back(entry.first, &entry.second);
+	}
+
+	std::vector<std::vector<Dependency>> tables(entries.size());
+	parallel::ForEach(entries.size(), 0, [&](size_t i)
+	{
+		ReadBND2Dependencies(*entries[i].second, tables[i]);
+	});
+
+	for (auto i = 0U; i < entries.size(); i++)
+	{
+		if (!tables[i].empty())
+			m_dependencies[entries[i].first] = std::move(tables[i]);
+	}
+
+	m_dependentsValid = false;
+	m_sync->dependenciesPending.store(false, std::memory_order_release);
 }
 
-std::optional<Bundle::EntryDebugInfo> Bundle::GetDebugInfo(uint32_t resourceID) const
+bool Bundle::ReadBND2Dependencies(const Entry &e, std::vector<Dependency> &dependencies) const
 {
-	const auto it = m_debugInfoEntries.find(resourceID);
-	if (it == m_debugInfoEntries.end())
-		return {};
-	
-	return it->second;
+	// Inflate through a small window, keeping only the table at the end of the block.
+	const auto depOffset = size_t(e.info.dependenciesOffset);
+	const auto depSize = size_t(e.info.numberOfDependencies) * DependencySize;
+	std::vector<uint8_t> table;
+	table.reserve(depSize);
+
+	auto offset = size_t(0);
+	InflateBlock(e.fileBlockData[0], 64 * 1024, [&](const uint8_t *data, size_t size)
+	{
+		const auto begin = std::max(offset, depOffset);
+		const auto end = std::min(offset + size, depOffset + depSize);
+		if (begin < end)
+			table.insert(table.end(), data + (begin - offset), data + (end - offset));
+		offset += size;
+		return table.size() < depSize;
+	});
+
+	if (table.size() < depSize)
+		return false;
+
+	if (m_platform != PC)
+		ReadDependencies<true>(table.data(), e.info.numberOfDependencies, dependencies);
+	else
+		ReadDependencies<false>(table.data(), e.info.numberOfDependencies, dependencies);
+	return true;
 }
 
-std::optional<Bundle::ResourceType> Bundle::GetResourceType(const std::string &resourceName) const
+void Bundle::ClearDependencies()
 {
-	return GetResourceType(HashResourceName(resourceName));
+	m_dependencies.clear();
+	m_dependents.clear();
+	m_dependentsValid = false;
+	m_sync->dependenciesPending = false;
 }
 
-std::optional<Bundle::ResourceType> Bundle::GetResourceType(uint32_t resourceID) const
+std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinary(std::string_view resourceName, uint32_t fileBlock) const
+{
+	return GetBinary(HashResourceName(resourceName), fileBlock);
+}
+
+std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinary(uint32_t resourceID, uint32_t fileBlock) const
 {
+	TraceAccess(resourceID);
+
 	const auto it = m_entries.find(resourceID);
 	if (it == m_entries.end())
 		return {};
 
-	return it->second.info.resourceType;
+	CountGetBinary(it->second.info.resourceType);
+	trace::Span span("GetBinary", resourceID);
+
+	return DecompressBlock(it->second.fileBlockData[fileBlock]);
 }
 
-bool Bundle::AddResource(const std::string &resourceName, const EntryData &data, Bundle::ResourceType resourceType)
+BufferPool::Buffer Bundle::GetPooledBinary(std::string_view resourceName, uint32_t fileBlock) const
 {
-	return AddResource(HashResourceName(resourceName), data, resourceType);
+	return GetPooledBinary(HashResourceName(resourceName), fileBlock);
 }
 
-bool Bundle::AddResource(uint32_t resourceID, const EntryData &data, Bundle::ResourceType resourceType)
+BufferPool::Buffer Bundle::GetPooledBinary(uint32_t resourceID, uint32_t fileBlock) const
 {
+	TraceAccess(resourceID);
+
 	const auto it = m_entries.find(resourceID);
-	if (it != m_entries.end() || data.dependencies.size() > std::numeric_limits<uint16_t>::max())
-		return false;
+	if (it == m_entries.end() || fileBlock >= 3)
+		return {};
 
-	Entry &e = m_entries[resourceID];
-	e.info.resourceType = resourceType;
+	CountGetBinary(it->second.info.resourceType);
+	trace::Span span("GetPooledBinary", resourceID);
 
-	return ReplaceResource(resourceID, data);
+	const auto &dataInfo = it->second.fileBlockData[fileBlock];
+	if (dataInfo.data == nullptr)
+		return {};
+
+	// Without a pool, hand out a plain buffer that the default recycler simply frees.
+	auto buffer = (m_bufferPool != nullptr)
+		? m_bufferPool->Acquire(dataInfo.uncompressedSize)
+		: BufferPool::Buffer(new std::vector<uint8_t>(dataInfo.uncompressedSize));
+	if (m_bufferPool == nullptr)
+		Add(m_sync->statistics.bytesAllocated, dataInfo.uncompressedSize);
+	if (!DecompressBlock(dataInfo, buffer->data()))
+		return {};
+
+	return buffer;
 }
 
-bool Bundle::AddDebugInfo(const std::string &resourceName, const std::string &name, const std::string &type)
+std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinaryPrefix(std::string_view resourceName, uint32_t fileBlock, size_t size) const
 {
-	return AddDebugInfo(HashResourceName(resourceName), name, type);
+	return GetBinaryPrefix(HashResourceName(resourceName), fileBlock, size);
 }
 
-bool Bundle::AddDebugInfo(uint32_t resourceID, const std::string &name, const std::string &type)
+std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinaryPrefix(uint32_t resourceID, uint32_t fileBlock, size_t size) const
 {
-	const auto it = m_debugInfoEntries.find(resourceID);
-	if (it != m_debugInfoEntries.end())
-		return false;
-
-	EntryDebugInfo &debugInfo = m_debugInfoEntries[resourceID];
-	debugInfo.name = name;
-	debugInfo.typeName = type;
+	TraceAccess(resourceID);
 
+	const auto it = m_entries.find(resourceID);
+	if (it == m_entries.end() || fileBlock >= 3)
+		return {};
+
+	CountGetBinary(it->second.info.resourceType);
+	trace::Span span("GetBinaryPrefix", resourceID);
+
+	const auto &dataInfo = it->second.fileBlockData[fileBlock];
+	if (dataInfo.data == nullptr)
+		return {};
+
+	size = std::min<size_t>(size, dataInfo.uncompressedSize);
+	if (dataInfo.compressedSize == 0)
+	{
+		size = std::min(size, dataInfo.data->size());
+		return std::make_unique<std::vector<uint8_t>>(dataInfo.data->begin(), dataInfo.data->begin() + size);
+	}
+
+	// Inflate straight into the result and stop as soon as it's full.
+	auto prefix = std::make_unique<std::vector<uint8_t>>(size);
+	Add(m_sync->statistics.bytesAllocated, size);
+	ScopedTimer timer(m_sync->statistics.inflateNanoseconds);
+	z_stream stream {};
+	stream.next_in = const_cast<Bytef *>(dataInfo.data->data());
+	stream.avail_in = static_cast<uInt>(dataInfo.data->size());
+	stream.next_out = prefix->data();
+	stream.avail_out = static_cast<uInt>(size);
+	if (inflateInit(&stream) != Z_OK)
+		return {};
+
+	auto ret = Z_OK;
+	while (ret == Z_OK && stream.avail_out > 0)
+		ret = inflate(&stream, Z_SYNC_FLUSH);
+	const auto produced = size - stream.avail_out;
+	inflateEnd(&stream);
+	Add(m_sync->statistics.bytesInflated, produced);
+
+	// Either full, or the block really is shorter than its stated size.
+	if (stream.avail_out > 0 && ret != Z_STREAM_END)
+		return {};
+
+	prefix->resize(produced);
+	return prefix;
+}
+
+std::unique_ptr<std::vector<uint8_t>> Bundle::DecompressBlock(const EntryFileBlockData &dataInfo) const
+{
+	if (dataInfo.data == nullptr)
+		return {};
+
+	auto uncompressedBuffer = std::make_unique<std::vector<uint8_t>>(dataInfo.uncompressedSize);
+	Add(m_sync->statistics.bytesAllocated, dataInfo.uncompressedSize);
+	if (!DecompressBlock(dataInfo, uncompressedBuffer->data()))
+		return {};
+
+	return uncompressedBuffer;
+}
+
+bool Bundle::DecompressBlock(const EntryFileBlockData &dataInfo, uint8_t *out) const
+{
+	const auto &buffer = dataInfo.data;
+	const auto uncompressedSize = dataInfo.uncompressedSize;
+
+	// Corrupt data fails here rather than in an assert, which wouldn't catch it in release builds.
+	if (dataInfo.compressedSize > 0)
+	{
+		if (buffer->size() < dataInfo.compressedSize)
+			return false;
+
+		trace::Span span("Inflate");
+		ScopedTimer timer(m_sync->statistics.inflateNanoseconds);
+		uLongf uncompressedSizeLong = uncompressedSize;
+		const auto ret = uncompress(out, &uncompressedSizeLong, buffer->data(), static_cast<uLong>(dataInfo.compressedSize));
+		Add(m_sync->statistics.bytesInflated, uncompressedSizeLong);
+
+		return ret == Z_OK && uncompressedSize == uncompressedSizeLong;
+	}
+
+	if (buffer->size() < uncompressedSize)
+		return false;
+
+	std::memcpy(out, buffer->data(), uncompressedSize);
 	return true;
 }
 
-bool Bundle::ReplaceResource(const std::string &resourceName, const EntryData &data)
+bool Bundle::StreamBinary(std::string_view resourceName, uint32_t fileBlock, const BinarySink &sink, size_t chunkSize) const
+{
+	return StreamBinary(HashResourceName(resourceName), fileBlock, sink, chunkSize);
+}
+
+bool Bundle::StreamBinary(uint32_t resourceID, uint32_t fileBlock, const BinarySink &sink, size_t chunkSize) const
+{
+	TraceAccess(resourceID);
+
+	const auto it = m_entries.find(resourceID);
+	if (it == m_entries.end() || fileBlock >= 3)
+		return false;
+
+	CountGetBinary(it->second.info.resourceType);
+	trace::Span span("StreamBinary", resourceID);
+
+	return InflateBlock(it->second.fileBlockData[fileBlock], chunkSize, sink);
+}
+
+bool Bundle::InflateBlock(const EntryFileBlockData &dataInfo, size_t chunkSize, const BinarySink &sink) const
+{
+	// Empty blocks have nothing to stream, but blocks filtered out on load can't be provided.
+	if (dataInfo.data == nullptr)
+		return dataInfo.uncompressedSize == 0;
+
+	chunkSize = std::clamp<size_t>(chunkSize, 1, std::numeric_limits<uInt>::max());
+
+	if (dataInfo.compressedSize == 0)
+	{
+		// Stored uncompressed, so hand out slices of the stored buffer.
+		const auto size = std::min<size_t>(dataInfo.uncompressedSize, dataInfo.data->size());
+		for (size_t offset = 0; offset < size; offset += chunkSize)
+		{
+			if (!sink(dataInfo.data->data() + offset, std::min(chunkSize, size - offset)))
+				break;
+		}
+		return true;
+	}
+
+	z_stream stream {};
+	stream.next_in = const_cast<Bytef *>(dataInfo.data->data());
+	stream.avail_in = static_cast<uInt>(dataInfo.data->size());
+	if (inflateInit(&stream) != Z_OK)
+		return false;
+
+	std::vector<uint8_t> chunk(std::min<size_t>(chunkSize, std::max<size_t>(dataInfo.uncompressedSize, 1)));
+	auto ret = Z_OK;
+	while (ret != Z_STREAM_END)
+	{
+		stream.next_out = chunk.data();
+		stream.avail_out = static_cast<uInt>(chunk.size());
+		{
+			ScopedTimer timer(m_sync->statistics.inflateNanoseconds);
+			ret = inflate(&stream, Z_NO_FLUSH);
+		}
+		if (ret != Z_OK && ret != Z_STREAM_END)
+			break;
+
+		const auto produced = chunk.size() - stream.avail_out;
+		Add(m_sync->statistics.bytesInflated, produced);
+		if (produced > 0 && !sink(chunk.data(), produced))
+		{
+			ret = Z_STREAM_END; // Stopped early by the sink, not an error.
+			break;
+		}
+	}
+
+	inflateEnd(&stream);
+	return ret == Z_STREAM_END;
+}
+
+std::optional<Bundle::EntryDebugInfo> Bundle::GetDebugInfo(std::string_view resourceName) const
+{
+	return GetDebugInfo(HashResourceName(resourceName));
+}
+
+std::optional<Bundle::EntryDebugInfo> Bundle::GetDebugInfo(uint32_t resourceID) const
+{
+	LoadDebugInfo();
+
+	const auto it = m_debugInfoEntries.find(resourceID);
+	if (it == m_debugInfoEntries.end())
+		return {};
+	
+	return EntryDebugInfo { std::string(it->second.name), std::string(it->second.typeName) };
+}
+
+std::optional<Bundle::EntryDebugInfoView> Bundle::GetDebugInfoView(std::string_view resourceName) const
+{
+	return GetDebugInfoView(HashResourceName(resourceName));
+}
+
+std::optional<Bundle::EntryDebugInfoView> Bundle::GetDebugInfoView(uint32_t resourceID) const
+{
+	LoadDebugInfo();
+
+	const auto it = m_debugInfoEntries.find(resourceID);
+	if (it == m_debugInfoEntries.end())
+		return {};
+
+	return it->second;
+}
+
+size_t Bundle::RecoverDebugInfo(const std::vector<std::string_view> &candidateNames, uint32_t threadCount)
+{
+	LoadDebugInfo();
+
+	// m_entries is sorted, so this is too.
+	std::vector<uint32_t> unnamed;
+	for (const auto &entry : m_entries)
+	{
+		if (m_debugInfoEntries.find(entry.first) == m_debugInfoEntries.end())
+			unnamed.push_back(entry.first);
+	}
+	if (unnamed.empty() || candidateNames.empty())
+		return 0;
+
+	// Most candidates miss, so check a bitmap of the top 20 ID bits (128 KiB) before the binary search.
+	constexpr auto filterShift = 12;
+	std::vector<uint64_t> filter((1 << (32 - filterShift)) / 64);
+	for (const auto resourceID : unnamed)
+		filter[resourceID >> (filterShift + 6)] |= uint64_t(1) << ((resourceID >> filterShift) & 63);
+
+	// The lowest matching candidate index wins, so the result doesn't depend on thread timing.
+	constexpr auto noMatch = std::numeric_limits<size_t>::max();
+	std::vector<std::atomic<size_t>> matches(unnamed.size());
+	for (auto &match : matches)
+		match.store(noMatch, std::memory_order_relaxed);
+
+	parallel::ForEachSlice(candidateNames.size(), threadCount, [&](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			const auto resourceID = HashResourceName(candidateNames[i]);
+			if ((filter[resourceID >> (filterShift + 6)] & (uint64_t(1) << ((resourceID >> filterShift) & 63))) == 0)
+				continue;
+
+			const auto it = std::lower_bound(unnamed.begin(), unnamed.end(), resourceID);
+			if (it == unnamed.end() || *it != resourceID)
+				continue;
+
+			auto &match = matches[it - unnamed.begin()];
+			auto current = match.load(std::memory_order_relaxed);
+			while (i < current && !match.compare_exchange_weak(current, i, std::memory_order_relaxed))
+			{
+			}
+		}
+	});
+
+	auto recovered = size_t(0);
+	for (auto i = 0U; i < unnamed.size(); i++)
+	{
+		const auto candidate = matches[i].load(std::memory_order_relaxed);
+		if (candidate == noMatch)
+			continue;
+
+		const auto resourceType = m_entries.at(unnamed[i]).info.resourceType;
+		auto typeName = GetResourceTypeName(resourceType);
+		std::array<char, 9> hexTypeName;
+		if (typeName.empty())
+		{
+			std::snprintf(hexTypeName.data(), hexTypeName.size(), "%x", static_cast<uint32_t>(resourceType));
+			typeName = hexTypeName.data();
+		}
+
+		m_debugInfoEntries[unnamed[i]] = { m_debugStrings.Intern(candidateNames[candidate]), m_debugStrings.Intern(typeName) };
+		recovered++;
+	}
+
+	return recovered;
+}
+
+std::string_view Bundle::GetResourceTypeName(ResourceType resourceType)
+{
+	switch (resourceType)
+	{
+	case Raster: return "Raster";
+	case Material: return "Material";
+	case ResourceMesh: return "ResourceMesh";
+	case TextFile: return "TextFile";
+	case DrawIndexParams: return "DrawIndexParams";
+	case IndexBuffer: return "IndexBuffer";
+	case MeshState: return "MeshState";
+	case VertexBuffer: return "VertexBuffer";
+	case VertexDesc: return "VertexDesc";
+	case MaterialCRC32: return "MaterialCRC32";
+	case Renderable: return "Renderable";
+	case MaterialTechnique: return "MaterialTechnique";
+	case TextureState: return "TextureState";
+	case MaterialState: return "MaterialState";
+	case DepthStencilState: return "DepthStencilState";
+	case RasterizerState: return "RasterizerState";
+	case ShaderProgramBuffer: return "ShaderProgramBuffer";
+	case ShaderParameter: return "ShaderParameter";
+	case RenderableAssembly: return "RenderableAssembly";
+	case Debug: return "Debug";
+	case KdTree: return "KdTree";
+	case VoiceHierarchy: return "VoiceHierarchy";
+	case Snr: return "Snr";
+	case InterpreterData: return "InterpreterData";
+	case AttribSysSchema: return "AttribSysSchema";
+	case AttribSysVault: return "AttribSysVault";
+	case EntryList: return "EntryList";
+	case AptDataHeader: return "AptDataHeader";
+	case GuiPopup: return "GuiPopup";
+	case Font: return "Font";
+	case LuaCode: return "LuaCode";
+	case InstanceList: return "InstanceList";
+	case CollisionMeshData: return "CollisionMeshData";
+	case IDList: return "IDList";
+	case InstanceCollisionList: return "InstanceCollisionList";
+	case Language: return "Language";
+	case SatNavTile: return "SatNavTile";
+	case SatNavTileDirectory: return "SatNavTileDirectory";
+	case Model: return "Model";
+	case RwColourCube: return "RwColourCube";
+	case HudMessage: return "HudMessage";
+	case HudMessageList: return "HudMessageList";
+	case HudMessageSequence: return "HudMessageSequence";
+	case HudMessageSequenceDictionary: return "HudMessageSequenceDictionary";
+	case WorldPainter2D: return "WorldPainter2D";
+	case PFXHookBundle: return "PFXHookBundle";
+	case Shader: return "Shader";
+	case RawFile: return "RawFile";
+	case ICETakeDictionary: return "ICETakeDictionary";
+	case VideoData: return "VideoData";
+	case PolygonSoupList: return "PolygonSoupList";
+	case CommsToolListDefinition: return "CommsToolListDefinition";
+	case CommsToolList: return "CommsToolList";
+	case BinaryFile: return "BinaryFile";
+	case AnimationCollection: return "AnimationCollection";
+	case Registry: return "Registry";
+	case GenericRwacWaveContent: return "GenericRwacWaveContent";
+	case GinsuWaveContent: return "GinsuWaveContent";
+	case AemsBank: return "AemsBank";
+	case Csis: return "Csis";
+	case Nicotine: return "Nicotine";
+	case Splicer: return "Splicer";
+	case FreqContent: return "FreqContent";
+	case VoiceHierarchyCollection: return "VoiceHierarchyCollection";
+	case GenericRwacReverbIRContent: return "GenericRwacReverbIRContent";
+	case SnapshotData: return "SnapshotData";
+	case ZoneList: return "ZoneList";
+	case LoopModel: return "LoopModel";
+	case AISections: return "AISections";
+	case TrafficData: return "TrafficData";
+	case Trigger: return "Trigger";
+	case DeformationModel: return "DeformationModel";
+	case VehicleList: return "VehicleList";
+	case GraphicsSpec: return "GraphicsSpec";
+	case PhysicsSpec: return "PhysicsSpec";
+	case ParticleDescriptionCollection: return "ParticleDescriptionCollection";
+	case WheelList: return "WheelList";
+	case WheelGraphicsSpec: return "WheelGraphicsSpec";
+	case TextureNameMap: return "TextureNameMap";
+	case ICEList: return "ICEList";
+	case ICEData: return "ICEData";
+	case Progression: return "Progression";
+	case PropPhysics: return "PropPhysics";
+	case PropGraphicsList: return "PropGraphicsList";
+	case PropInstanceData: return "PropInstanceData";
+	case BrnEnvironmentKeyframe: return "BrnEnvironmentKeyframe";
+	case BrnEnvironmentTimeLine: return "BrnEnvironmentTimeLine";
+	case BrnEnvironmentDictionary: return "BrnEnvironmentDictionary";
+	case GraphicsStub: return "GraphicsStub";
+	case StaticSoundMap: return "StaticSoundMap";
+	case StreetData: return "StreetData";
+	case BrnVFXMeshCollection: return "BrnVFXMeshCollection";
+	case MassiveLookupTable: return "MassiveLookupTable";
+	case VFXPropCollection: return "VFXPropCollection";
+	case StreamedDeformationSpec: return "StreamedDeformationSpec";
+	case ParticleDescription: return "ParticleDescription";
+	case PlayerCarColours: return "PlayerCarColours";
+	case ChallengeList: return "ChallengeList";
+	case FlaptFile: return "FlaptFile";
+	case ProfileUpgrade: return "ProfileUpgrade";
+	case VehicleAnimation: return "VehicleAnimation";
+	case BodypartRemapping: return "BodypartRemapping";
+	case LUAList: return "LUAList";
+	case LUAScript: return "LUAScript";
+	case BkSoundWeapon: return "BkSoundWeapon";
+	case BkSoundGunsu: return "BkSoundGunsu";
+	case BkSoundBulletImpact: return "BkSoundBulletImpact";
+	case BkSoundBulletImpactList: return "BkSoundBulletImpactList";
+	case BkSoundBulletImpactStream: return "BkSoundBulletImpactStream";
+	default: return {};
+	}
+}
+
+std::optional<Bundle::ResourceType> Bundle::GetResourceType(std::string_view resourceName) const
+{
+	return GetResourceType(HashResourceName(resourceName));
+}
+
+std::optional<Bundle::ResourceType> Bundle::GetResourceType(uint32_t resourceID) const
+{
+	const auto it = m_entries.find(resourceID);
+	if (it == m_entries.end())
+		return {};
+
+	return it->second.info.resourceType;
+}
+
+std::optional<uint32_t> Bundle::GetUncompressedSize(uint32_t resourceID, uint32_t fileBlock) const
+{
+	const auto it = m_entries.find(resourceID);
+	if (it == m_entries.end() || fileBlock >= 3)
+		return {};
+
+	return it->second.fileBlockData[fileBlock].uncompressedSize;
+}
+
+bool Bundle::AddResource(std::string_view resourceName, const EntryData &data, Bundle::ResourceType resourceType)
+{
+	return AddResource(HashResourceName(resourceName), data, resourceType);
+}
+
+bool Bundle::AddResource(uint32_t resourceID, const EntryData &data, Bundle::ResourceType resourceType)
+{
+	if (!AddEntry(resourceID, data, resourceType))
+		return false;
+
+	return ReplaceResource(resourceID, data);
+}
+
+bool Bundle::AddEntry(uint32_t resourceID, const EntryData &data, ResourceType resourceType)
+{
+	const auto it = m_entries.find(resourceID);
+	if (it != m_entries.end() || data.dependencies.size() > std::numeric_limits<uint16_t>::max())
+		return false;
+
+	Entry &e = m_entries[resourceID];
+	e.info.resourceType = resourceType;
+
+	auto &ids = m_entriesByType[resourceType];
+	ids.insert(std::lower_bound(ids.begin(), ids.end(), resourceID), resourceID);
+	m_getBinaryCalls.try_emplace(resourceType, 0);
+
+	return true;
+}
+
+bool Bundle::AddResource(std::string_view resourceName, EntryData &&data, Bundle::ResourceType resourceType)
+{
+	return AddResource(HashResourceName(resourceName), std::move(data), resourceType);
+}
+
+bool Bundle::AddResource(uint32_t resourceID, EntryData &&data, Bundle::ResourceType resourceType)
+{
+	if (!AddEntry(resourceID, data, resourceType))
+		return false;
+
+	return ReplaceResource(resourceID, std::move(data));
+}
+
+bool Bundle::AddDebugInfo(std::string_view resourceName, std::string_view name, std::string_view type)
+{
+	return AddDebugInfo(HashResourceName(resourceName), name, type);
+}
+
+bool Bundle::AddDebugInfo(uint32_t resourceID, std::string_view name, std::string_view type)
+{
+	LoadDebugInfo();
+
+	const auto it = m_debugInfoEntries.find(resourceID);
+	if (it != m_debugInfoEntries.end())
+		return false;
+
+	m_debugInfoEntries[resourceID] = { m_debugStrings.Intern(name), m_debugStrings.Intern(type) };
+
+	return true;
+}
+
+bool Bundle::ReplaceResource(std::string_view resourceName, const EntryData &data)
 {
 	return ReplaceResource(HashResourceName(resourceName), data);
 }
 
 bool Bundle::ReplaceResource(uint32_t resourceID, const EntryData &data)
 {
-	const auto it = m_entries.find(resourceID);
-	if (it == m_entries.end() || data.dependencies.size() > std::numeric_limits<uint16_t>::max())
+	const auto e = BeginReplaceResource(resourceID, data.dependencies);
+	if (e == nullptr)
+		return false;
+
+	for (auto i = 0; i < 3; i++)
+	{
+		if (!StoreBlock(*e, i, data.fileBlockData[i].get(), nullptr, data.dependencies, data.alignments[i]))
+			return false;
+	}
+
+	return true;
+}
+
+bool Bundle::ReplaceResource(std::string_view resourceName, EntryData &&data)
+{
+	return ReplaceResource(HashResourceName(resourceName), std::move(data));
+}
+
+bool Bundle::ReplaceResource(uint32_t resourceID, EntryData &&data)
+{
+	const auto e = BeginReplaceResource(resourceID, data.dependencies);
+	if (e == nullptr)
 		return false;
 
+	for (auto i = 0; i < 3; i++)
+	{
+		const auto source = data.fileBlockData[i].get();
+		if (!StoreBlock(*e, i, source, std::move(data.fileBlockData[i]), data.dependencies, data.alignments[i]))
+			return false;
+	}
+
+	return true;
+}
+
+Bundle::Entry *Bundle::BeginReplaceResource(uint32_t resourceID, const std::vector<Dependency> &dependencies)
+{
+	const auto it = m_entries.find(resourceID);
+	if (it == m_entries.end() || dependencies.size() > std::numeric_limits<uint16_t>::max())
+		return nullptr;
+
 	Entry &e = it->second;
 
+	m_contentHashes.erase(resourceID);
+	e.modified = true;
 	e.info.checksum = 0;
 	e.info.dependenciesOffset = 0;
 	e.info.numberOfDependencies = 0;
 
-	for (auto i = 0; i < 3; i++)
+	// BNDL stores dependencies separately from the data; for BND2 this keeps the graph up to date.
+	if (dependencies.empty())
+		m_dependencies.erase(resourceID);
+	else
+		m_dependencies[resourceID] = dependencies;
+	m_dependentsValid = false;
+	if (m_magicVersion == BNDL)
+		e.info.numberOfDependencies = static_cast<uint16_t>(dependencies.size());
+
+	return &e;
+}
+
+// source is the block's new data. If owned is set it holds source and may be reused or extended in
+// place; otherwise source belongs to the caller and is only read.
+bool Bundle::StoreBlock(Entry &e, int fileBlock, const std::vector<uint8_t> *source, std::unique_ptr<std::vector<uint8_t>> owned,
+	const std::vector<Dependency> &dependencies, uint32_t alignment)
+{
+	auto &outDataInfo = e.fileBlockData[fileBlock];
+
+	if (source == nullptr || source->empty())
 	{
-		const auto &inDataInfo = data.fileBlockData[i];
-		auto &outDataInfo = e.fileBlockData[i];
+		outDataInfo.data = nullptr;
+		outDataInfo.uncompressedSize = 0;
+		outDataInfo.compressedSize = 0;
+		return true;
+	}
 
-		if (inDataInfo == nullptr || inDataInfo->empty())
+	if (m_magicVersion == BND2 && fileBlock == 0 && !dependencies.empty())
+	{
+		for (const auto &dependency : dependencies)
+			e.info.checksum &= dependency.resourceID;
+
+		// Dependencies follow the data directly, so GetData gives back exactly the data that was
+		// added. They're in the platform's byte order, the same as GetData and Load read them.
+		const auto inSize = source->size();
+		const auto totalSize = inSize + dependencies.size() * DependencySize;
+		if (owned == nullptr)
 		{
-			outDataInfo.data = nullptr;
-			outDataInfo.uncompressedSize = 0;
-			outDataInfo.compressedSize = 0;
-			continue;
+			owned = std::make_unique<std::vector<uint8_t>>();
+			owned->reserve(totalSize);
+			owned->assign(source->begin(), source->end());
 		}
+		owned->resize(totalSize);
+		if (m_platform != PC)
+			WriteDependencies<true>(owned->data() + inSize, dependencies);
+		else
+			WriteDependencies<false>(owned->data() + inSize, dependencies);
+		source = owned.get();
 
-		std::unique_ptr<std::vector<uint8_t>> inBuffer;
-		std::unique_ptr<std::vector<uint8_t>> outBuffer;
+		e.info.dependenciesOffset = static_cast<uint32_t>(inSize);
+		e.info.numberOfDependencies = static_cast<uint16_t>(dependencies.size());
+	}
 
-		if (m_magicVersion == BND2 && i == 0 && !data.dependencies.empty())
+	outDataInfo.uncompressedSize = static_cast<uint32_t>(source->size());
+	outDataInfo.uncompressedAlignment = alignment;
+	outDataInfo.compressionDeferred = false;
+
+	if ((m_flags & Compressed) && !m_deferredCompression)
+	{
+		// Compress straight from the source; the uncompressed data isn't kept.
+		if (!CompressBlock(*source, outDataInfo))
 		{
-			binaryio::BinaryWriter writer;
-			for (const auto &dependency : data.dependencies)
-			{
-				WriteDependency(writer, dependency);
-				e.info.checksum &= dependency.resourceID;
-			}
-			const auto depSize = writer.GetSize();
-			auto depStream = writer.GetStream();
-
-			const auto inSize = inDataInfo->size();
-			binaryio::Align(inSize, 16);
-			inBuffer = std::make_unique<std::vector<uint8_t>>(inSize + depSize);
-			inBuffer->assign(inDataInfo->begin(), inDataInfo->end());
-			inBuffer->resize(inSize);
-			inBuffer->insert(inBuffer->end(), std::istreambuf_iterator<char>(depStream), std::istreambuf_iterator<char>());
-
-			e.info.dependenciesOffset = static_cast<uint32_t>(inSize);
-			e.info.numberOfDependencies = static_cast<uint16_t>(data.dependencies.size());
+			assert(0);
+			return false;
 		}
-		else
+	}
+	else
+	{
+		if (owned == nullptr)
+			owned = std::make_unique<std::vector<uint8_t>>(*source);
+		outDataInfo.compressedSize = 0;
+		outDataInfo.data = std::move(owned);
+		outDataInfo.compressionDeferred = (m_flags & Compressed) != 0;
+	}
+
+	return true;
+}
+
+bool Bundle::CompressBlock(const std::vector<uint8_t> &source, EntryFileBlockData &dataInfo) const
+{
+	const auto compBufferSize = compressBound(static_cast<uLong>(source.size()));
+	auto outBuffer = std::make_unique<std::vector<uint8_t>>(compBufferSize);
+	Add(m_sync->statistics.bytesAllocated, compBufferSize);
+	uLongf actualSize = compBufferSize;
+	int ret;
+	{
+		ScopedTimer timer(m_sync->statistics.deflateNanoseconds);
+		ret = compress2(outBuffer->data(), &actualSize, source.data(), static_cast<uLong>(source.size()), Z_BEST_COMPRESSION);
+	}
+	if (ret != Z_OK)
+		return false;
+
+	Add(m_sync->statistics.bytesDeflated, source.size());
+
+	outBuffer->resize(actualSize);
+	outBuffer->shrink_to_fit();
+	dataInfo.compressedSize = static_cast<uint32_t>(actualSize);
+	dataInfo.data = std::move(outBuffer);
+	dataInfo.compressionDeferred = false;
+	return true;
+}
+
+bool Bundle::CompressDeferredBlocks(uint32_t threadCount)
+{
+	std::vector<EntryFileBlockData *> blocks;
+	for (auto &entry : m_entries)
+	{
+		for (auto &dataInfo : entry.second.fileBlockData)
+		{
+			if (dataInfo.compressionDeferred)
+				blocks.push_back(&dataInfo);
+		}
+	}
+
+	std::atomic<bool> compressed = true;
+	parallel::ForEach(blocks.size(), threadCount, [&](size_t i)
+	{
+		auto &dataInfo = *blocks[i];
+		auto source = std::move(dataInfo.data);
+		if (!CompressBlock(*source, dataInfo))
+		{
+			dataInfo.data = std::move(source);
+			compressed = false;
+		}
+	});
+
+	return compressed;
+}
+
+template <bool BigEndian>
+void Bundle::WriteDependencies(uint8_t *data, const std::vector<Dependency> &dependencies)
+{
+	for (const auto &dependency : dependencies)
+	{
+		endian::Store<BigEndian, uint64_t>(data, dependency.resourceID);
+		endian::Store<BigEndian, uint32_t>(data + 8, dependency.internalOffset);
+		endian::Store<BigEndian, uint32_t>(data + 12, 0);
+		data += DependencySize;
+	}
+}
+
+std::optional<uint64_t> Bundle::GetContentHash(uint32_t resourceID, uint32_t fileBlock) const
+{
+	if (fileBlock >= 3)
+		return {};
+
+	const auto hashes = GetContentHashes(resourceID);
+	if (!hashes)
+		return {};
+
+	return (*hashes)[fileBlock];
+}
+
+std::optional<uint64_t> Bundle::GetContentHash(std::string_view resourceName) const
+{
+	return GetContentHash(HashResourceName(resourceName));
+}
+
+std::optional<uint64_t> Bundle::GetContentHash(uint32_t resourceID) const
+{
+	const auto hashes = GetContentHashes(resourceID);
+	if (!hashes)
+		return {};
+
+	// Serialized little endian, so the same content hashes the same on every host.
+	uint8_t bytes[3 * sizeof(uint64_t)];
+	for (auto i = 0U; i < 3; i++)
+		endian::Store<false, uint64_t>(bytes + i * sizeof(uint64_t), (*hashes)[i]);
+	return xxh64::Hash(bytes, sizeof(bytes));
+}
+
+void Bundle::PrecomputeContentHashes(uint32_t threadCount) const
+{
+	std::vector<std::pair<uint32_t, const Entry *>> entries;
+	{
+		std::lock_guard<std::mutex> lock(m_sync->contentHashMutex);
+		for (const auto &entry : m_entries)
 		{
-			inBuffer = std::make_unique<std::vector<uint8_t>>(inDataInfo->begin(), inDataInfo->end());
+			if (m_contentHashes.find(entry.first) == m_contentHashes.end())
+				entries.emplace_back(entry.first, &entry.second);
 		}
+	}
+
+	std::vector<std::array<uint64_t, 3>> hashes(entries.size());
+	std::vector<uint8_t> hashed(entries.size());
+	parallel::ForEach(entries.size(), threadCount, [&](size_t i)
+	{
+		hashed[i] = HashContent(*entries[i].second, hashes[i]);
+	});
+
+	std::lock_guard<std::mutex> lock(m_sync->contentHashMutex);
+	for (auto i = 0U; i < entries.size(); i++)
+	{
+		if (hashed[i])
+			m_contentHashes[entries[i].first] = hashes[i];
+	}
+}
+
+std::optional<std::array<uint64_t, 3>> Bundle::GetContentHashes(uint32_t resourceID) const
+{
+	const auto it = m_entries.find(resourceID);
+	if (it == m_entries.end())
+		return {};
 
-		const auto uncompressedSize = static_cast<uint32_t>(inBuffer->size());
+	{
+		std::lock_guard<std::mutex> lock(m_sync->contentHashMutex);
+		const auto cached = m_contentHashes.find(resourceID);
+		if (cached != m_contentHashes.end())
+			return cached->second;
+	}
+
+	// Hash without holding the lock, so other resources can be hashed at the same time.
+	std::array<uint64_t, 3> hashes;
+	if (!HashContent(it->second, hashes))
+		return {};
 
-		if (m_flags & Compressed)
+	std::lock_guard<std::mutex> lock(m_sync->contentHashMutex);
+	m_contentHashes[resourceID] = hashes;
+	return hashes;
+}
+
+bool Bundle::HashContent(const Entry &e, std::array<uint64_t, 3> &hashes) const
+{
+	for (auto i = 0; i < 3; i++)
+	{
+		const auto &dataInfo = e.fileBlockData[i];
+		xxh64::State state;
+		auto size = size_t(0);
+		const auto inflated = InflateBlock(dataInfo, 256 * 1024, [&](const uint8_t *data, size_t chunkSize)
 		{
-			const auto compBufferSize = compressBound(static_cast<uLong>(inBuffer->size()));
-			outBuffer = std::make_unique<std::vector<uint8_t>>(compBufferSize);
-			uLongf actualSize = compBufferSize;
-			const auto ret = compress2(outBuffer->data(), &actualSize, inBuffer->data(), static_cast<uLong>(inBuffer->size()), Z_BEST_COMPRESSION);
+			state.Update(data, chunkSize);
+			size += chunkSize;
+			return true;
+		});
+		if (!inflated || (dataInfo.data != nullptr && size != dataInfo.uncompressedSize))
+			return false;
 
-			if (ret != Z_OK)
+		hashes[i] = state.Digest();
+	}
+
+	return true;
+}
+
+std::vector<Bundle::VerifyIssue> Bundle::Verify(uint32_t threadCount) const
+{
+	// BND2 dependency tables are checked by VerifyEntry as part of inflating block 0, so they
+	// aren't loaded here.
+	LoadDebugInfo();
+
+	std::vector<std::pair<uint32_t, const Entry *>> entries;
+	entries.reserve(m_entries.size());
+	for (const auto &entry : m_entries)
+		entries.emplace_back(entry.first, &entry.second);
+
+	std::vector<std::vector<VerifyIssue>> entryIssues(entries.size());
+	parallel::ForEach(entries.size(), threadCount, [&](size_t i)
+	{
+		VerifyEntry(entries[i].first, *entries[i].second, entryIssues[i]);
+	});
+
+	std::vector<VerifyIssue> issues;
+	for (auto &entry : entryIssues)
+		std::move(entry.begin(), entry.end(), std::back_inserter(issues));
+
+	for (const auto &debugInfo : m_debugInfoEntries)
+	{
+		if (m_entries.find(debugInfo.first) == m_entries.end())
+			issues.push_back({ debugInfo.first, -1, "String table entry without a resource" });
+	}
+
+	return issues;
+}
+
+void Bundle::VerifyEntry(uint32_t resourceID, const Entry &e, std::vector<VerifyIssue> &issues) const
+{
+	const auto report = [&](int32_t fileBlock, std::string message)
+	{
+		issues.push_back({ resourceID, fileBlock, std::move(message) });
+	};
+
+	// The BND2 dependency table is collected from block 0 while it's checked, so it's only inflated once.
+	const auto hasTable = m_magicVersion == BND2 && e.info.numberOfDependencies > 0;
+	const auto tableOffset = size_t(e.info.dependenciesOffset);
+	const auto tableSize = size_t(e.info.numberOfDependencies) * DependencySize;
+	if (hasTable && tableOffset + tableSize > e.fileBlockData[0].uncompressedSize)
+		report(0, "Dependency table is out of bounds");
+	const auto readTable = hasTable && tableOffset + tableSize <= e.fileBlockData[0].uncompressedSize;
+	std::vector<uint8_t> table;
+	auto tableChecked = false;
+	const auto collectTable = [&](const uint8_t *data, size_t offset, size_t size)
+	{
+		const auto begin = std::max(offset, tableOffset);
+		const auto end = std::min(offset + size, tableOffset + tableSize);
+		if (begin < end)
+			table.insert(table.end(), data + (begin - offset), data + (end - offset));
+	};
+
+	for (auto i = 0; i < 3; i++)
+	{
+		const auto &dataInfo = e.fileBlockData[i];
+		const auto alignment = dataInfo.uncompressedAlignment;
+		if (dataInfo.uncompressedSize > 0 && (alignment == 0 || (alignment & (alignment - 1)) != 0))
+			report(i, "Alignment " + std::to_string(alignment) + " is not a power of two");
+
+		// Empty, or filtered out on load.
+		if (dataInfo.data == nullptr)
+			continue;
+
+		if (dataInfo.compressedSize > 0 && (m_flags & Compressed) == 0)
+			report(i, "Compressed block in an uncompressed bundle");
+
+		const auto storedSize = (dataInfo.compressedSize > 0) ? dataInfo.compressedSize : dataInfo.uncompressedSize;
+		if (dataInfo.data->size() != storedSize)
+		{
+			report(i, "Stored size is " + std::to_string(storedSize) + " but the block has " + std::to_string(dataInfo.data->size()) + " bytes");
+			continue;
+		}
+
+		const auto collect = i == 0 && readTable;
+		tableChecked = tableChecked || collect;
+		if (dataInfo.compressedSize > 0)
+		{
+			auto inflatedSize = size_t(0);
+			const auto inflated = InflateBlock(dataInfo, 256 * 1024, [&](const uint8_t *data, size_t size)
 			{
-				assert(0);
-				return false;
-			}
+				if (collect)
+					collectTable(data, inflatedSize, size);
+				inflatedSize += size;
+				return inflatedSize <= dataInfo.uncompressedSize;
+			});
+
+			if (!inflated)
+				report(i, "Compressed data is corrupt");
+			else if (inflatedSize != dataInfo.uncompressedSize)
+				report(i, "Inflates to " + std::string(inflatedSize > dataInfo.uncompressedSize ? "more than " : "") + std::to_string(inflatedSize)
+					+ " bytes, expected " + std::to_string(dataInfo.uncompressedSize));
+		}
+		else if (collect)
+		{
+			collectTable(dataInfo.data->data(), 0, dataInfo.data->size());
+		}
+	}
 
-			outBuffer->shrink_to_fit();
-			outDataInfo.compressedSize = actualSize;
+	if (m_magicVersion == BND2)
+	{
+		if (!tableChecked)
+			return;
+
+		if (table.size() < tableSize)
+		{
+			report(0, "Dependency table can't be read");
+			return;
 		}
+
+		std::vector<Dependency> dependencies;
+		if (m_platform != PC)
+			ReadDependencies<true>(table.data(), e.info.numberOfDependencies, dependencies);
 		else
+			ReadDependencies<false>(table.data(), e.info.numberOfDependencies, dependencies);
+		// The offsets are where the pointers to the dependencies are patched in, so they must lie
+		// in the data before the table.
+		for (size_t i = 0; i < dependencies.size(); i++)
 		{
-			outBuffer = std::move(inBuffer);
-			outDataInfo.compressedSize = 0;
+			if (dependencies[i].internalOffset >= tableOffset)
+				report(0, "Dependency " + std::to_string(i) + " is at offset " + std::to_string(dependencies[i].internalOffset)
+					+ ", past the resource data");
 		}
+	}
+	else
+	{
+		const auto it = m_dependencies.find(resourceID);
+		const auto count = (it != m_dependencies.end()) ? it->second.size() : 0;
+		if (count != e.info.numberOfDependencies)
+			report(-1, "Has " + std::to_string(count) + " dependencies, expected " + std::to_string(e.info.numberOfDependencies));
+	}
+}
 
-		outDataInfo.uncompressedSize = uncompressedSize;
-		outDataInfo.data = std::move(outBuffer);
-		outDataInfo.uncompressedAlignment = data.alignments[i];
+Bundle::Statistics Bundle::GetStatistics() const
+{
+	Statistics statistics;
+	statistics.bytesRead = m_sync->statistics.bytesRead.load(std::memory_order_relaxed);
+	statistics.bytesInflated = m_sync->statistics.bytesInflated.load(std::memory_order_relaxed);
+	statistics.bytesDeflated = m_sync->statistics.bytesDeflated.load(std::memory_order_relaxed);
+	statistics.inflateNanoseconds = m_sync->statistics.inflateNanoseconds.load(std::memory_order_relaxed);
+	statistics.deflateNanoseconds = m_sync->statistics.deflateNanoseconds.load(std::memory_order_relaxed);
+	statistics.debugInfoParseNanoseconds = m_sync->statistics.debugInfoParseNanoseconds.load(std::memory_order_relaxed);
+	statistics.bytesAllocated = m_sync->statistics.bytesAllocated.load(std::memory_order_relaxed);
+	for (const auto &calls : m_getBinaryCalls)
+	{
+		const auto count = calls.second.load(std::memory_order_relaxed);
+		if (count > 0)
+			statistics.getBinaryCalls[calls.first] = count;
 	}
+	return statistics;
+}
 
-	return true;
+void Bundle::ResetStatistics()
+{
+	for (auto counter : { &m_sync->statistics.bytesRead, &m_sync->statistics.bytesInflated, &m_sync->statistics.bytesDeflated, &m_sync->statistics.inflateNanoseconds,
+		&m_sync->statistics.deflateNanoseconds, &m_sync->statistics.debugInfoParseNanoseconds, &m_sync->statistics.bytesAllocated })
+		counter->store(0, std::memory_order_relaxed);
+	for (auto &calls : m_getBinaryCalls)
+		calls.second.store(0, std::memory_order_relaxed);
+}
+
+void Bundle::CountGetBinary(ResourceType resourceType) const
+{
+	const auto it = m_getBinaryCalls.find(resourceType);
+	if (it != m_getBinaryCalls.end())
+		it->second.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Bundle::ReportStatistics() const
+{
+	if (m_statisticsCallback)
+		m_statisticsCallback(GetStatistics());
+}
+
+void Bundle::StartAccessTrace()
+{
+	std::lock_guard<std::mutex> lock(m_sync->accessTraceMutex);
+	m_accessTrace.clear();
+	m_accessTraced.clear();
+	m_sync->accessTracing = true;
 }
 
-void Bundle::WriteDependency(binaryio::BinaryWriter &writer, const Dependency &dependency)
+void Bundle::StopAccessTrace()
 {
-	writer.Write<uint64_t>(dependency.resourceID);
-	writer.Write(dependency.internalOffset);
-	writer.Align(8);
+	m_sync->accessTracing = false;
+}
+
+std::vector<uint32_t> Bundle::GetAccessTrace() const
+{
+	std::lock_guard<std::mutex> lock(m_sync->accessTraceMutex);
+	return m_accessTrace;
+}
+
+void Bundle::TraceAccess(uint32_t resourceID) const
+{
+	if (!m_sync->accessTracing.load(std::memory_order_relaxed))
+		return;
+
+	std::lock_guard<std::mutex> lock(m_sync->accessTraceMutex);
+	if (m_entries.find(resourceID) != m_entries.end() && m_accessTraced.insert(resourceID).second)
+		m_accessTrace.push_back(resourceID);
+}
+
+std::vector<std::map<uint32_t, Bundle::Entry>::const_iterator> Bundle::GetDataLayoutOrder() const
+{
+	std::vector<std::map<uint32_t, Entry>::const_iterator> order;
+	order.reserve(m_entries.size());
+
+	std::unordered_set<uint32_t> placed;
+	for (const auto resourceID : m_dataLayout)
+	{
+		const auto it = m_entries.find(resourceID);
+		if (it != m_entries.end() && placed.insert(resourceID).second)
+			order.push_back(it);
+	}
+
+	for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+	{
+		if (placed.find(it->first) == placed.end())
+			order.push_back(it);
+	}
+
+	return order;
+}
+
+bool Bundle::IsModified(std::string_view resourceName) const
+{
+	return IsModified(HashResourceName(resourceName));
+}
+
+bool Bundle::IsModified(uint32_t resourceID) const
+{
+	const auto it = m_entries.find(resourceID);
+	if (it == m_entries.end())
+		return false;
+
+	return it->second.modified;
+}
+
+std::vector<uint32_t> Bundle::ListModifiedResources() const
+{
+	std::vector<uint32_t> entries;
+	for (const auto &e : m_entries)
+	{
+		if (e.second.modified)
+			entries.push_back(e.first);
+	}
+	return entries;
 }
 
 std::vector<uint32_t> Bundle::ListResourceIDs() const
@@ -1078,10 +2636,41 @@ std::vector<uint32_t> Bundle::ListResourceIDs() const
 
 std::map<Bundle::ResourceType, std::vector<uint32_t>> Bundle::ListResourceIDsByType() const
 {
-	std::map<ResourceType, std::vector<uint32_t>> entriesByResourceType;
-	for (const auto &e : m_entries)
+	return m_entriesByType;
+}
+
+const std::vector<uint32_t> &Bundle::GetResourceIDsByType(ResourceType resourceType) const
+{
+	static const std::vector<uint32_t> none;
+
+	const auto it = m_entriesByType.find(resourceType);
+	if (it == m_entriesByType.end())
+		return none;
+
+	return it->second;
+}
+
+void Bundle::ForEachResource(const std::function<void(uint32_t, const EntryInfo &)> &visitor, ExecutionPolicy policy, uint32_t threadCount) const
+{
+	if (policy == ExecutionPolicy::Sequential)
+		threadCount = 1;
+
+	parallel::ForEachSlice(m_entries.size(), threadCount, [&](size_t begin, size_t end)
 	{
-		entriesByResourceType[e.second.info.resourceType].push_back(e.first);
-	}
-	return entriesByResourceType;
+		auto it = std::next(m_entries.begin(), begin);
+		for (auto i = begin; i < end; i++, ++it)
+			visitor(it->first, it->second.info);
+	});
+}
+
+void Bundle::RebuildTypeIndex()
+{
+	m_entriesByType.clear();
+
+	// m_entries is sorted, so every list is too.
+	for (const auto &e : m_entries)
+		m_entriesByType[e.second.info.resourceType].push_back(e.first);
+
+	for (const auto &type : m_entriesByType)
+		m_getBinaryCalls.try_emplace(type.first, 0);
 }
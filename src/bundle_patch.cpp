@@ -0,0 +1,556 @@
+#include <libbndl/bundle_patch.hpp>
+#include <fstream>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include "endian.hpp"
+#include "parallel.hpp"
+#include "xxh64.hpp"
+
+using namespace libbndl;
+
+namespace
+{
+	constexpr uint32_t PatchVersion = 1;
+
+	enum BlockFlags : uint8_t
+	{
+		BlockHasData = 1,
+		BlockCompressionDeferred = 2,
+	};
+
+	// Patch files are little endian on every platform.
+	class PatchWriter
+	{
+	public:
+		template <typename T>
+		void Write(T value)
+		{
+			uint8_t bytes[sizeof(T)];
+			endian::Store<false, T>(bytes, value);
+			Write(bytes, sizeof(T));
+		}
+
+		void Write(const void *data, size_t size)
+		{
+			const auto bytes = static_cast<const uint8_t *>(data);
+			m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+		}
+
+		void WriteString(std::string_view str)
+		{
+			Write(static_cast<uint32_t>(str.size()));
+			Write(str.data(), str.size());
+		}
+
+		const std::vector<uint8_t> &GetBuffer() const
+		{
+			return m_buffer;
+		}
+
+	private:
+		std::vector<uint8_t> m_buffer;
+	};
+
+	// Reads past the end yield zeroes and mark the reader as failed.
+	class PatchReader
+	{
+	public:
+		explicit PatchReader(const std::vector<uint8_t> &buffer)
+			: m_pos(buffer.data()), m_end(buffer.data() + buffer.size())
+		{
+		}
+
+		template <typename T>
+		T Read()
+		{
+			if (size_t(m_end - m_pos) < sizeof(T))
+			{
+				m_failed = true;
+				return T();
+			}
+			return endian::Read<false, T>(m_pos);
+		}
+
+		bool Read(std::vector<uint8_t> &data, size_t size)
+		{
+			if (size_t(m_end - m_pos) < size)
+			{
+				m_failed = true;
+				return false;
+			}
+			data.assign(m_pos, m_pos + size);
+			m_pos += size;
+			return true;
+		}
+
+		std::string ReadString()
+		{
+			const auto size = Read<uint32_t>();
+			if (size_t(m_end - m_pos) < size)
+			{
+				m_failed = true;
+				return {};
+			}
+			std::string str(reinterpret_cast<const char *>(m_pos), size);
+			m_pos += size;
+			return str;
+		}
+
+		// A count of items that each take at least itemSize bytes, or 0 if there isn't room for them.
+		uint32_t ReadCount(size_t itemSize)
+		{
+			const auto count = Read<uint32_t>();
+			if (count > size_t(m_end - m_pos) / itemSize)
+			{
+				m_failed = true;
+				return 0;
+			}
+			return count;
+		}
+
+		bool Failed() const
+		{
+			return m_failed;
+		}
+
+		bool AtEnd() const
+		{
+			return m_pos == m_end;
+		}
+
+	private:
+		const uint8_t *m_pos;
+		const uint8_t *m_end;
+		bool m_failed = false;
+	};
+
+	void UpdateHash(xxh64::State &state, uint64_t value)
+	{
+		uint8_t bytes[sizeof(value)];
+		endian::Store<false, uint64_t>(bytes, value);
+		state.Update(bytes, sizeof(bytes));
+	}
+
+	void UpdateHash(xxh64::State &state, std::string_view str)
+	{
+		UpdateHash(state, str.size());
+		state.Update(str.data(), str.size());
+	}
+}
+
+BundlePatch::Header BundlePatch::GetHeader(const Bundle &bundle)
+{
+	return { bundle.m_magicVersion, bundle.m_revisionNumber, bundle.m_platform, bundle.m_flags };
+}
+
+bool BundlePatch::HasAllData(const Bundle &bundle)
+{
+	for (const auto &entry : bundle.m_entries)
+	{
+		for (const auto &dataInfo : entry.second.fileBlockData)
+		{
+			const auto storedSize = dataInfo.compressedSize > 0 ? dataInfo.compressedSize : dataInfo.uncompressedSize;
+			if (storedSize > 0 && dataInfo.data == nullptr)
+				return false;
+		}
+	}
+	return true;
+}
+
+uint64_t BundlePatch::HashEntry(const Bundle &bundle, uint32_t resourceID, const Bundle::Entry &entry)
+{
+	xxh64::State state;
+	UpdateHash(state, resourceID);
+	UpdateHash(state, entry.info.checksum);
+	// BNDL dependency offsets point into the file and are recomputed on save.
+	if (bundle.m_magicVersion == Bundle::BND2)
+		UpdateHash(state, entry.info.dependenciesOffset);
+	UpdateHash(state, entry.info.resourceType);
+	UpdateHash(state, entry.info.numberOfDependencies);
+
+	for (const auto &dataInfo : entry.fileBlockData)
+	{
+		UpdateHash(state, dataInfo.uncompressedSize);
+		UpdateHash(state, dataInfo.uncompressedAlignment);
+		UpdateHash(state, dataInfo.compressedSize);
+		UpdateHash(state, dataInfo.compressionDeferred);
+		UpdateHash(state, dataInfo.data != nullptr ? dataInfo.data->size() : 0);
+		if (dataInfo.data != nullptr)
+			state.Update(dataInfo.data->data(), dataInfo.data->size());
+	}
+
+	// BND2 dependencies are part of block 0.
+	if (bundle.m_magicVersion == Bundle::BNDL)
+	{
+		const auto it = bundle.m_dependencies.find(resourceID);
+		if (it != bundle.m_dependencies.end())
+		{
+			for (const auto &dependency : it->second)
+			{
+				UpdateHash(state, dependency.resourceID);
+				UpdateHash(state, dependency.internalOffset);
+			}
+		}
+	}
+
+	return state.Digest();
+}
+
+std::vector<uint64_t> BundlePatch::HashEntries(const Bundle &bundle)
+{
+	std::vector<std::pair<uint32_t, const Bundle::Entry *>> entries;
+	entries.reserve(bundle.m_entries.size());
+	for (const auto &entry : bundle.m_entries)
+		entries.emplace_back(entry.first, &entry.second);
+
+	std::vector<uint64_t> hashes(entries.size());
+	parallel::ForEach(entries.size(), 0, [&](size_t i)
+	{
+		hashes[i] = HashEntry(bundle, entries[i].first, *entries[i].second);
+	});
+
+	return hashes;
+}
+
+uint64_t BundlePatch::Fingerprint(const Bundle &bundle, const std::vector<uint64_t> &entryHashes)
+{
+	xxh64::State state;
+	const auto header = GetHeader(bundle);
+	UpdateHash(state, header.magicVersion);
+	UpdateHash(state, header.revisionNumber);
+	UpdateHash(state, header.platform);
+	UpdateHash(state, header.flags);
+
+	for (const auto hash : entryHashes)
+		UpdateHash(state, hash);
+
+	bundle.LoadDebugInfo();
+	for (const auto &entry : bundle.m_debugInfoEntries)
+	{
+		UpdateHash(state, entry.first);
+		UpdateHash(state, entry.second.name);
+		UpdateHash(state, entry.second.typeName);
+	}
+
+	return state.Digest();
+}
+
+bool BundlePatch::Create(const Bundle &from, const Bundle &to)
+{
+	if (!HasAllData(from) || !HasAllData(to))
+		return false;
+
+	BundlePatch patch;
+	patch.m_from = GetHeader(from);
+	patch.m_to = GetHeader(to);
+
+	// Entries can only be kept as they are if they are stored the same way.
+	const auto compatible = patch.m_from.magicVersion == patch.m_to.magicVersion && patch.m_from.platform == patch.m_to.platform
+		&& (patch.m_from.flags & Bundle::Compressed) == (patch.m_to.flags & Bundle::Compressed);
+
+	const auto fromHashes = HashEntries(from);
+	const auto toHashes = HashEntries(to);
+	patch.m_fromFingerprint = Fingerprint(from, fromHashes);
+
+	// Both maps are sorted, so walk them side by side.
+	auto fromIt = from.m_entries.begin();
+	auto toIt = to.m_entries.begin();
+	auto fromIndex = size_t(0);
+	auto toIndex = size_t(0);
+	while (fromIt != from.m_entries.end() || toIt != to.m_entries.end())
+	{
+		if (toIt == to.m_entries.end() || (fromIt != from.m_entries.end() && fromIt->first < toIt->first))
+		{
+			patch.m_removedResources.push_back(fromIt->first);
+			++fromIt, fromIndex++;
+			continue;
+		}
+
+		if (fromIt != from.m_entries.end() && fromIt->first == toIt->first)
+		{
+			const auto unchanged = compatible && fromHashes[fromIndex] == toHashes[toIndex];
+			++fromIt, fromIndex++;
+			if (unchanged)
+			{
+				++toIt, toIndex++;
+				continue;
+			}
+		}
+
+		const auto &entry = toIt->second;
+		Resource resource;
+		resource.resourceID = toIt->first;
+		resource.info = entry.info;
+		for (auto i = 0; i < 3; i++)
+		{
+			const auto &dataInfo = entry.fileBlockData[i];
+			auto &block = resource.fileBlockData[i];
+			block.uncompressedSize = dataInfo.uncompressedSize;
+			block.uncompressedAlignment = dataInfo.uncompressedAlignment;
+			block.compressedSize = dataInfo.compressedSize;
+			block.compressionDeferred = dataInfo.compressionDeferred;
+			block.hasData = dataInfo.data != nullptr;
+			if (block.hasData)
+				block.data = *dataInfo.data;
+		}
+		if (to.m_magicVersion == Bundle::BNDL)
+		{
+			const auto it = to.m_dependencies.find(resource.resourceID);
+			if (it != to.m_dependencies.end())
+				resource.dependencies = it->second;
+		}
+		patch.m_resources.push_back(std::move(resource));
+
+		++toIt, toIndex++;
+	}
+
+	from.LoadDebugInfo();
+	to.LoadDebugInfo();
+	auto fromDebugIt = from.m_debugInfoEntries.begin();
+	auto toDebugIt = to.m_debugInfoEntries.begin();
+	while (fromDebugIt != from.m_debugInfoEntries.end() || toDebugIt != to.m_debugInfoEntries.end())
+	{
+		if (toDebugIt == to.m_debugInfoEntries.end() || (fromDebugIt != from.m_debugInfoEntries.end() && fromDebugIt->first < toDebugIt->first))
+		{
+			patch.m_debugInfoChanges.push_back({ fromDebugIt->first, false, {}, {} });
+			++fromDebugIt;
+			continue;
+		}
+
+		if (fromDebugIt != from.m_debugInfoEntries.end() && fromDebugIt->first == toDebugIt->first)
+		{
+			const auto unchanged = fromDebugIt->second.name == toDebugIt->second.name && fromDebugIt->second.typeName == toDebugIt->second.typeName;
+			++fromDebugIt;
+			if (unchanged)
+			{
+				++toDebugIt;
+				continue;
+			}
+		}
+
+		patch.m_debugInfoChanges.push_back({ toDebugIt->first, true, std::string(toDebugIt->second.name), std::string(toDebugIt->second.typeName) });
+		++toDebugIt;
+	}
+
+	*this = std::move(patch);
+	return true;
+}
+
+bool BundlePatch::Apply(Bundle &bundle) const
+{
+	const auto header = GetHeader(bundle);
+	if (header.magicVersion != m_from.magicVersion || header.revisionNumber != m_from.revisionNumber
+		|| header.platform != m_from.platform || header.flags != m_from.flags)
+		return false;
+
+	if (!HasAllData(bundle) || Fingerprint(bundle, HashEntries(bundle)) != m_fromFingerprint)
+		return false;
+
+	// BND2 dependencies are read from the data again on first use; BNDL keeps the untouched ones.
+	if (m_to.magicVersion == Bundle::BND2 || m_from.magicVersion != m_to.magicVersion)
+		bundle.ClearDependencies();
+
+	for (const auto resourceID : m_removedResources)
+	{
+		bundle.m_contentHashes.erase(resourceID);
+		bundle.m_entries.erase(resourceID);
+		bundle.m_dependencies.erase(resourceID);
+	}
+
+	for (const auto &resource : m_resources)
+	{
+		bundle.m_contentHashes.erase(resource.resourceID);
+		auto &entry = bundle.m_entries[resource.resourceID];
+		entry.info = resource.info;
+		entry.modified = true;
+		for (auto i = 0; i < 3; i++)
+		{
+			const auto &block = resource.fileBlockData[i];
+			auto &dataInfo = entry.fileBlockData[i];
+			dataInfo.uncompressedSize = block.uncompressedSize;
+			dataInfo.uncompressedAlignment = block.uncompressedAlignment;
+			dataInfo.compressedSize = block.compressedSize;
+			dataInfo.compressionDeferred = block.compressionDeferred;
+			dataInfo.data = block.hasData ? std::make_unique<std::vector<uint8_t>>(block.data) : nullptr;
+		}
+
+		if (m_to.magicVersion == Bundle::BNDL)
+		{
+			if (resource.dependencies.empty())
+				bundle.m_dependencies.erase(resource.resourceID);
+			else
+				bundle.m_dependencies[resource.resourceID] = resource.dependencies;
+		}
+	}
+
+	for (const auto &change : m_debugInfoChanges)
+	{
+		if (change.present)
+			bundle.m_debugInfoEntries[change.resourceID] = { bundle.m_debugStrings.Intern(change.name), bundle.m_debugStrings.Intern(change.typeName) };
+		else
+			bundle.m_debugInfoEntries.erase(change.resourceID);
+	}
+
+	bundle.m_magicVersion = m_to.magicVersion;
+	bundle.m_revisionNumber = m_to.revisionNumber;
+	bundle.m_platform = m_to.platform;
+	bundle.m_flags = m_to.flags;
+
+	if (bundle.m_magicVersion == Bundle::BND2)
+		bundle.m_sync->dependenciesPending = true;
+	bundle.m_dependentsValid = false;
+	bundle.RebuildTypeIndex();
+
+	return true;
+}
+
+std::vector<uint32_t> BundlePatch::GetChangedResources() const
+{
+	std::vector<uint32_t> resourceIDs;
+	resourceIDs.reserve(m_resources.size());
+	for (const auto &resource : m_resources)
+		resourceIDs.push_back(resource.resourceID);
+	return resourceIDs;
+}
+
+bool BundlePatch::Save(const std::string &name) const
+{
+	PatchWriter writer;
+	writer.Write("bpat", 4);
+	writer.Write(PatchVersion);
+
+	for (const auto &header : { m_from, m_to })
+	{
+		writer.Write(static_cast<uint32_t>(header.magicVersion));
+		writer.Write(header.revisionNumber);
+		writer.Write(static_cast<uint32_t>(header.platform));
+		writer.Write(static_cast<uint32_t>(header.flags));
+	}
+	writer.Write(m_fromFingerprint);
+
+	writer.Write(static_cast<uint32_t>(m_removedResources.size()));
+	for (const auto resourceID : m_removedResources)
+		writer.Write(resourceID);
+
+	writer.Write(static_cast<uint32_t>(m_resources.size()));
+	for (const auto &resource : m_resources)
+	{
+		writer.Write(resource.resourceID);
+		writer.Write(resource.info.checksum);
+		writer.Write(resource.info.dependenciesOffset);
+		writer.Write(static_cast<uint32_t>(resource.info.resourceType));
+		writer.Write(resource.info.numberOfDependencies);
+
+		for (const auto &block : resource.fileBlockData)
+		{
+			writer.Write(block.uncompressedSize);
+			writer.Write(block.uncompressedAlignment);
+			writer.Write(block.compressedSize);
+			writer.Write(static_cast<uint8_t>((block.hasData ? BlockHasData : 0) | (block.compressionDeferred ? BlockCompressionDeferred : 0)));
+			if (block.hasData)
+			{
+				writer.Write(static_cast<uint32_t>(block.data.size()));
+				writer.Write(block.data.data(), block.data.size());
+			}
+		}
+
+		writer.Write(static_cast<uint32_t>(resource.dependencies.size()));
+		for (const auto &dependency : resource.dependencies)
+		{
+			writer.Write(dependency.resourceID);
+			writer.Write(dependency.internalOffset);
+		}
+	}
+
+	writer.Write(static_cast<uint32_t>(m_debugInfoChanges.size()));
+	for (const auto &change : m_debugInfoChanges)
+	{
+		writer.Write(change.resourceID);
+		writer.Write(static_cast<uint8_t>(change.present));
+		writer.WriteString(change.name);
+		writer.WriteString(change.typeName);
+	}
+
+	std::ofstream f(name, std::ios::out | std::ios::binary);
+	const auto &buffer = writer.GetBuffer();
+	f.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+	return !f.fail();
+}
+
+bool BundlePatch::Load(const std::string &name)
+{
+	std::ifstream f(name, std::ios::in | std::ios::binary);
+	if (f.fail())
+		return false;
+
+	const std::vector<uint8_t> buffer { std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>() };
+	PatchReader reader(buffer);
+
+	if (buffer.size() < 8 || std::memcmp(buffer.data(), "bpat", 4) != 0)
+		return false;
+	reader.Read<uint32_t>();
+	if (reader.Read<uint32_t>() != PatchVersion)
+		return false;
+
+	BundlePatch patch;
+	for (auto header : { &patch.m_from, &patch.m_to })
+	{
+		header->magicVersion = static_cast<Bundle::MagicVersion>(reader.Read<uint32_t>());
+		header->revisionNumber = reader.Read<uint32_t>();
+		header->platform = static_cast<Bundle::Platform>(reader.Read<uint32_t>());
+		header->flags = static_cast<Bundle::Flags>(reader.Read<uint32_t>());
+	}
+	patch.m_fromFingerprint = reader.Read<uint64_t>();
+
+	patch.m_removedResources.resize(reader.ReadCount(sizeof(uint32_t)));
+	for (auto &resourceID : patch.m_removedResources)
+		resourceID = reader.Read<uint32_t>();
+
+	patch.m_resources.resize(reader.ReadCount(0x12 + 3 * 0xD + 4));
+	for (auto &resource : patch.m_resources)
+	{
+		resource.resourceID = reader.Read<uint32_t>();
+		resource.info.checksum = reader.Read<uint32_t>();
+		resource.info.dependenciesOffset = reader.Read<uint32_t>();
+		resource.info.resourceType = static_cast<Bundle::ResourceType>(reader.Read<uint32_t>());
+		resource.info.numberOfDependencies = reader.Read<uint16_t>();
+
+		for (auto &block : resource.fileBlockData)
+		{
+			block.uncompressedSize = reader.Read<uint32_t>();
+			block.uncompressedAlignment = reader.Read<uint32_t>();
+			block.compressedSize = reader.Read<uint32_t>();
+			const auto flags = reader.Read<uint8_t>();
+			block.hasData = (flags & BlockHasData) != 0;
+			block.compressionDeferred = (flags & BlockCompressionDeferred) != 0;
+			if (block.hasData && !reader.Read(block.data, reader.Read<uint32_t>()))
+				return false;
+		}
+
+		resource.dependencies.resize(reader.ReadCount(8));
+		for (auto &dependency : resource.dependencies)
+		{
+			dependency.resourceID = reader.Read<uint32_t>();
+			dependency.internalOffset = reader.Read<uint32_t>();
+		}
+
+		if (reader.Failed())
+			return false;
+	}
+
+	patch.m_debugInfoChanges.resize(reader.ReadCount(13));
+	for (auto &change : patch.m_debugInfoChanges)
+	{
+		change.resourceID = reader.Read<uint32_t>();
+		change.present = reader.Read<uint8_t>() != 0;
+		change.name = reader.ReadString();
+		change.typeName = reader.ReadString();
+	}
+
+	if (reader.Failed() || !reader.AtEnd())
+		return false;
+
+	*this = std::move(patch);
+	return true;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSSE3__)
+#	include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define LIBBNDL_ENDIAN_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#	include <arm_neon.h>
+#	define LIBBNDL_ENDIAN_NEON
+#endif
+
+#if defined(_MSC_VER)
+#	include <stdlib.h>
+#endif
+
+// Endianness-specialized codecs. Every function is templated on the byte order of the data, so
+// callers pick the little or big endian variant once per bundle and read without per-field checks.
+namespace libbndl::endian
+{
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	constexpr bool NativeBigEndian = false;
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	constexpr bool NativeBigEndian = true;
+#else
+#	error "Unsupported byte order."
+#endif
+
+	inline uint16_t ByteSwap(uint16_t value)
+	{
+#if defined(_MSC_VER)
+		return _byteswap_ushort(value);
+#else
+		return __builtin_bswap16(value);
+#endif
+	}
+
+	inline uint32_t ByteSwap(uint32_t value)
+	{
+#if defined(_MSC_VER)
+		return _byteswap_ulong(value);
+#else
+		return __builtin_bswap32(value);
+#endif
+	}
+
+	inline uint64_t ByteSwap(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		return _byteswap_uint64(value);
+#else
+		return __builtin_bswap64(value);
+#endif
+	}
+
+	inline uint8_t ByteSwap(uint8_t value)
+	{
+		return value;
+	}
+
+	template <bool BigEndian, typename T>
+	inline T Load(const uint8_t *src)
+	{
+		std::make_unsigned_t<T> value;
+		std::memcpy(&value, src, sizeof(value));
+		if constexpr (BigEndian != NativeBigEndian)
+			value = ByteSwap(value);
+		return static_cast<T>(value);
+	}
+
+	template <bool BigEndian, typename T>
+	inline T Read(const uint8_t *&src)
+	{
+		const auto value = Load<BigEndian, T>(src);
+		src += sizeof(T);
+		return value;
+	}
+
+	template <bool BigEndian, typename T>
+	inline void Store(uint8_t *dst, T value)
+	{
+		auto raw = static_cast<std::make_unsigned_t<T>>(value);
+		if constexpr (BigEndian != NativeBigEndian)
+			raw = ByteSwap(raw);
+		std::memcpy(dst, &raw, sizeof(raw));
+	}
+
+	// Converts a table of 32-bit words into host order, four words at a time where SIMD is available.
+	template <bool BigEndian>
+	inline void LoadArray(uint32_t *dst, const uint8_t *src, size_t count)
+	{
+		if constexpr (BigEndian == NativeBigEndian)
+		{
+			if (count > 0)
+				std::memcpy(dst, src, count * sizeof(uint32_t));
+		}
+		else
+		{
+			size_t i = 0;
+#if defined(__SSSE3__)
+			const auto mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+			for (; i + 4 <= count; i += 4)
+			{
+				const auto words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(words, mask));
+			}
+#elif defined(LIBBNDL_ENDIAN_SSE2)
+			for (; i + 4 <= count; i += 4)
+			{
+				auto words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+				words = _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+				words = _mm_shufflelo_epi16(words, _MM_SHUFFLE(2, 3, 0, 1));
+				words = _mm_shufflehi_epi16(words, _MM_SHUFFLE(2, 3, 0, 1));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), words);
+			}
+#elif defined(LIBBNDL_ENDIAN_NEON)
+			for (; i + 4 <= count; i += 4)
+				vst1q_u8(reinterpret_cast<uint8_t *>(dst + i), vrev32q_u8(vld1q_u8(src + i * 4)));
+#endif
+			for (; i < count; i++)
+				dst[i] = Load<BigEndian, uint32_t>(src + i * 4);
+		}
+	}
+}
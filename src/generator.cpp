@@ -0,0 +1,205 @@
+#include <libbndl/generator.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <unordered_set>
+#include "parallel.hpp"
+
+using namespace libbndl;
+
+namespace
+{
+	// BNDL stores the string table as a resource with this ID, so no generated resource may have it.
+	constexpr auto ResourceStringTableID = 0xC039284AU;
+
+	// Resources are generated, added and compressed in batches, so only one batch of uncompressed
+	// data is held at a time.
+	constexpr size_t BatchSize = 4096;
+
+	// SplitMix64: small, fast, and good enough to make test data from.
+	class Random
+	{
+	public:
+		explicit Random(uint64_t seed) : m_state(seed) {}
+
+		uint64_t Next()
+		{
+			auto z = (m_state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+
+		// Uniform in [min, max].
+		uint32_t Between(uint32_t min, uint32_t max)
+		{
+			if (min >= max)
+				return min;
+			return min + static_cast<uint32_t>(Next() % (uint64_t(max) - min + 1));
+		}
+
+		double Unit()
+		{
+			return (Next() >> 11) * (1.0 / (uint64_t(1) << 53));
+		}
+
+	private:
+		uint64_t m_state;
+	};
+
+	void FillData(std::vector<uint8_t> &data, uint32_t maxRunLength, Random &random)
+	{
+		for (size_t i = 0; i < data.size();)
+		{
+			const auto value = random.Next();
+			const auto run = std::min<size_t>(1 + value % maxRunLength, data.size() - i);
+			std::fill_n(data.begin() + i, run, static_cast<uint8_t>(value >> 32));
+			i += run;
+		}
+	}
+
+	// The same name the debug info of real bundles uses, or the type in hex if it's unknown.
+	std::string TypeName(Bundle::ResourceType resourceType)
+	{
+		const auto typeName = Bundle::GetResourceTypeName(resourceType);
+		if (!typeName.empty())
+			return std::string(typeName);
+
+		char hexTypeName[9];
+		std::snprintf(hexTypeName, sizeof(hexTypeName), "%x", static_cast<uint32_t>(resourceType));
+		return hexTypeName;
+	}
+
+	bool IsValid(const GeneratorOptions &options, uint32_t revisionNumber)
+	{
+		if (options.resourceTypes.empty() || options.maxRunLength == 0)
+			return false;
+
+		// The BND2 ID block keeps the alignment in the top 4 bits of the size.
+		for (auto i = 0; i < 3; i++)
+		{
+			if (options.minBlockSizes[i] > options.maxBlockSizes[i] || options.maxBlockSizes[i] >= (1U << 28))
+				return false;
+		}
+
+		if (options.magicVersion == Bundle::BND2)
+			return revisionNumber == 2 && options.platform == Bundle::PC;
+		if (options.magicVersion == Bundle::BNDL)
+			return revisionNumber >= 3 && revisionNumber <= 5 && (revisionNumber >= 4 || !options.compressed)
+				&& (options.platform == Bundle::PC || options.platform == Bundle::Xbox360 || options.platform == Bundle::PS3);
+		return false;
+	}
+}
+
+std::unique_ptr<Bundle> libbndl::GenerateBundle(const GeneratorOptions &options)
+{
+	auto revisionNumber = options.revisionNumber;
+	if (revisionNumber == 0)
+		revisionNumber = (options.magicVersion == Bundle::BND2) ? 2 : 5;
+	if (!IsValid(options, revisionNumber))
+		return nullptr;
+
+	auto flags = Bundle::UnusedFlag1 | Bundle::UnusedFlag2;
+	if (options.compressed)
+		flags |= Bundle::Compressed;
+	if (options.resourceStringTable)
+		flags |= Bundle::HasResourceStringTable;
+
+	auto bundle = std::make_unique<Bundle>(options.magicVersion, revisionNumber, options.platform, static_cast<Bundle::Flags>(flags));
+	bundle->SetDeferredCompression(true);
+
+	std::vector<std::string> typeNames;
+	for (const auto resourceType : options.resourceTypes)
+		typeNames.push_back(TypeName(resourceType));
+
+	// Names first, so dependencies can refer to the IDs of earlier resources. On the rare hash
+	// collision the name gets a suffix until it's unique. The names are only kept for the string table.
+	std::vector<std::string> names(options.resourceStringTable ? options.resourceCount : 0);
+	std::vector<uint32_t> resourceIDs(options.resourceCount);
+	std::unordered_set<uint32_t> usedIDs;
+	usedIDs.reserve(options.resourceCount);
+	char name[128];
+	for (auto i = 0U; i < options.resourceCount; i++)
+	{
+		const auto &typeName = typeNames[i % typeNames.size()];
+		for (auto attempt = 0U;; attempt++)
+		{
+			if (attempt == 0)
+				std::snprintf(name, sizeof(name), "generated://%s/%u", typeName.c_str(), i);
+			else
+				std::snprintf(name, sizeof(name), "generated://%s/%u~%u", typeName.c_str(), i, attempt);
+
+			const auto resourceID = Bundle::HashResourceName(name);
+			if (resourceID != 0 && resourceID != ResourceStringTableID && usedIDs.insert(resourceID).second)
+			{
+				if (options.resourceStringTable)
+					names[i] = name;
+				resourceIDs[i] = resourceID;
+				break;
+			}
+		}
+	}
+
+	std::vector<Bundle::EntryData> batch;
+	for (size_t batchStart = 0; batchStart < options.resourceCount; batchStart += BatchSize)
+	{
+		const auto batchEnd = std::min<size_t>(batchStart + BatchSize, options.resourceCount);
+		batch.clear();
+		batch.resize(batchEnd - batchStart);
+
+		// Every resource has its own random stream, so the result doesn't depend on the threads.
+		parallel::ForEach(batch.size(), options.threadCount, [&](size_t i)
+		{
+			const auto index = batchStart + i;
+			Random random(options.seed ^ (index * 0xD1B54A32D192ED03ULL));
+			auto &data = batch[i];
+
+			for (auto j = 0; j < 3; j++)
+			{
+				auto size = random.Between(options.minBlockSizes[j], options.maxBlockSizes[j]);
+				data.alignments[j] = (j == 0) ? 16 : 128;
+				if (size == 0)
+					continue;
+
+				data.fileBlockData[j] = std::make_unique<std::vector<uint8_t>>(size);
+				FillData(*data.fileBlockData[j], options.maxRunLength, random);
+			}
+
+			// Dependencies are pointers within block 0, so there must be one to point into.
+			if (index == 0 || data.fileBlockData[0] == nullptr || options.dependencyDensity <= 0.0)
+				return;
+
+			const auto whole = static_cast<uint32_t>(options.dependencyDensity);
+			auto count = whole + ((random.Unit() < options.dependencyDensity - whole) ? 1 : 0);
+			count = std::min<uint32_t>({ count, static_cast<uint32_t>(index), 0xFFFF });
+			const auto blockSize = static_cast<uint32_t>(data.fileBlockData[0]->size());
+			for (auto k = 0U; k < count; k++)
+			{
+				const auto target = resourceIDs[random.Next() % index];
+				const auto internalOffset = random.Between(0, (blockSize - 1) / 4) * 4;
+				data.dependencies.push_back({ target, internalOffset });
+			}
+		});
+
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			const auto index = batchStart + i;
+			const auto typeIndex = index % options.resourceTypes.size();
+			if (!bundle->AddResource(resourceIDs[index], std::move(batch[i]), options.resourceTypes[typeIndex]))
+				return nullptr;
+
+			if (options.resourceStringTable && !bundle->AddDebugInfo(resourceIDs[index], names[index], typeNames[typeIndex]))
+				return nullptr;
+		}
+
+		if (options.compressed && !bundle->CompressDeferredBlocks(options.threadCount))
+			return nullptr;
+	}
+
+	return bundle;
+}
+
+bool libbndl::GenerateBundle(const GeneratorOptions &options, const std::string &fileName)
+{
+	const auto bundle = GenerateBundle(options);
+	return bundle != nullptr && bundle->Save(fileName);
+}
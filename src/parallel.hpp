@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libbndl::parallel
+{
+	// 0 means one thread per hardware thread. Never more threads than there are work items.
+	inline uint32_t ResolveThreadCount(uint32_t threadCount, size_t workItems)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1U, std::thread::hardware_concurrency());
+		return static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(threadCount, workItems)));
+	}
+
+	// Keeps the first exception thrown on any of the threads, to be rethrown on the calling thread
+	// once they've all been joined.
+	class FirstException
+	{
+	public:
+		void Capture()
+		{
+			std::lock_guard lock(m_mutex);
+			if (m_exception == nullptr)
+				m_exception = std::current_exception();
+		}
+
+		void Rethrow() const
+		{
+			if (m_exception != nullptr)
+				std::rethrow_exception(m_exception);
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::exception_ptr m_exception;
+	};
+
+	// Calls body(begin, end) for contiguous slices of [0, count), one slice per thread. The calling
+	// thread takes the first slice. If body throws, the first exception is rethrown after all the
+	// slices are done.
+	template <typename Body>
+	void ForEachSlice(size_t count, uint32_t threadCount, Body &&body)
+	{
+		threadCount = ResolveThreadCount(threadCount, count);
+		if (threadCount == 1)
+		{
+			body(size_t(0), count);
+			return;
+		}
+
+		FirstException exception;
+		const auto slice = [&body, &exception](size_t begin, size_t end)
+		{
+			try
+			{
+				body(begin, end);
+			}
+			catch (...)
+			{
+				exception.Capture();
+			}
+		};
+
+		const auto sliceSize = (count + threadCount - 1) / threadCount;
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		for (auto i = 1U; i < threadCount; i++)
+		{
+			const auto begin = std::min(count, i * sliceSize);
+			const auto end = std::min(count, begin + sliceSize);
+			threads.emplace_back(slice, begin, end);
+		}
+
+		slice(size_t(0), std::min(count, sliceSize));
+
+		for (auto &thread : threads)
+			thread.join();
+		exception.Rethrow();
+	}
+
+	// Calls body(index) for every index in [0, count). Indices are handed out one at a time, so
+	// items of uneven cost still balance across threads. If body throws, no more indices are
+	// handed out, and the first exception is rethrown once the threads have stopped.
+	template <typename Body>
+	void ForEach(size_t count, uint32_t threadCount, Body &&body)
+	{
+		threadCount = ResolveThreadCount(threadCount, count);
+		if (threadCount == 1)
+		{
+			for (size_t i = 0; i < count; i++)
+				body(i);
+			return;
+		}
+
+		std::atomic<size_t> next = 0;
+		FirstException exception;
+		const auto worker = [&body, &next, &exception, count]()
+		{
+			try
+			{
+				for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < count; i = next.fetch_add(1, std::memory_order_relaxed))
+					body(i);
+			}
+			catch (...)
+			{
+				exception.Capture();
+				next.store(count, std::memory_order_relaxed);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		for (auto i = 1U; i < threadCount; i++)
+			threads.emplace_back(worker);
+
+		worker();
+
+		for (auto &thread : threads)
+			thread.join();
+		exception.Rethrow();
+	}
+}
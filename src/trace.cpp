@@ -0,0 +1,127 @@
+#include <libbndl/trace.hpp>
+#include "trace_span.hpp"
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+using namespace libbndl;
+
+std::atomic<bool> trace::g_enabled = false;
+
+namespace
+{
+	struct Event
+	{
+		const char *name;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point end;
+		uint32_t threadID;
+		bool hasResourceID;
+		uint32_t resourceID;
+	};
+
+	struct TraceState
+	{
+		std::mutex mutex;
+		std::ofstream file;
+		std::chrono::steady_clock::time_point epoch;
+		std::vector<Event> events;
+	};
+
+	TraceState &GetState()
+	{
+		static TraceState state;
+		return state;
+	}
+
+	// Small sequential IDs read better in the viewer than hashed std::thread::ids.
+	uint32_t CurrentThreadID()
+	{
+		static std::atomic<uint32_t> nextThreadID = 1;
+		thread_local const auto threadID = nextThreadID.fetch_add(1, std::memory_order_relaxed);
+		return threadID;
+	}
+
+	double Microseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+}
+
+void trace::Record(const char *name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end,
+	bool hasResourceID, uint32_t resourceID)
+{
+	const auto threadID = CurrentThreadID();
+
+	auto &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	// Tracing may have stopped while the span was open.
+	if (!g_enabled.load(std::memory_order_relaxed))
+		return;
+	state.events.push_back({ name, start, end, threadID, hasResourceID, resourceID });
+}
+
+bool libbndl::StartTracing(const std::string &fileName)
+{
+	auto &state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	if (trace::g_enabled.load(std::memory_order_relaxed))
+		return false;
+
+	state.file.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (state.file.fail())
+	{
+		state.file.clear();
+		return false;
+	}
+
+	state.events.clear();
+	state.epoch = std::chrono::steady_clock::now();
+	trace::g_enabled.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+bool libbndl::StopTracing()
+{
+	auto &state = GetState();
+	std::vector<Event> events;
+	std::ofstream file;
+	std::chrono::steady_clock::time_point epoch;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (!trace::g_enabled.load(std::memory_order_relaxed))
+			return false;
+
+		trace::g_enabled.store(false, std::memory_order_relaxed);
+		events.swap(state.events);
+		file.swap(state.file);
+		epoch = state.epoch;
+	}
+
+	// Complete ("X") events; the viewer nests spans on the same thread by their times.
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	char buffer[256];
+	for (auto i = 0U; i < events.size(); i++)
+	{
+		const auto &event = events[i];
+		std::snprintf(buffer, sizeof(buffer), "%s\n{\"name\":\"%s\",\"cat\":\"libbndl\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+			(i > 0) ? "," : "", event.name, event.threadID, Microseconds(event.start - epoch), Microseconds(event.end - event.start));
+		file << buffer;
+		if (event.hasResourceID)
+		{
+			std::snprintf(buffer, sizeof(buffer), ",\"args\":{\"resourceID\":\"%08x\"}", event.resourceID);
+			file << buffer;
+		}
+		file << '}';
+	}
+	file << "\n]}\n";
+	file.close();
+
+	return !file.fail();
+}
+
+bool libbndl::IsTracing()
+{
+	return trace::g_enabled.load(std::memory_order_relaxed);
+}
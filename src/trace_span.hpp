@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace libbndl::trace
+{
+	extern std::atomic<bool> g_enabled;
+
+	void Record(const char *name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end,
+		bool hasResourceID, uint32_t resourceID);
+
+	// Records the time from construction until End or destruction, if tracing is on. Costs one
+	// relaxed load otherwise. Names must be string literals.
+	class Span
+	{
+	public:
+		explicit Span(const char *name)
+			: m_name(g_enabled.load(std::memory_order_relaxed) ? name : nullptr)
+		{
+			if (m_name != nullptr)
+				m_start = std::chrono::steady_clock::now();
+		}
+
+		Span(const char *name, uint32_t resourceID)
+			: Span(name)
+		{
+			m_hasResourceID = true;
+			m_resourceID = resourceID;
+		}
+
+		~Span()
+		{
+			End();
+		}
+
+		Span(const Span &) = delete;
+		Span &operator=(const Span &) = delete;
+
+		void End()
+		{
+			if (m_name == nullptr)
+				return;
+			Record(m_name, m_start, std::chrono::steady_clock::now(), m_hasResourceID, m_resourceID);
+			m_name = nullptr;
+		}
+
+	private:
+		const char *m_name;
+		std::chrono::steady_clock::time_point m_start;
+		bool m_hasResourceID = false;
+		uint32_t m_resourceID = 0;
+	};
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "endian.hpp"
+
+// XXH64 (https://github.com/Cyan4973/xxHash), a fast non-cryptographic 64-bit hash. Used for
+// content hashes and patch fingerprints; the results match the reference implementation.
+namespace libbndl::xxh64
+{
+	constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+	constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	constexpr uint64_t Prime3 = 0x165667B19E3779F9ULL;
+	constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+	constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+	inline uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	inline uint64_t Round(uint64_t acc, uint64_t input)
+	{
+		acc += input * Prime2;
+		acc = RotateLeft(acc, 31);
+		return acc * Prime1;
+	}
+
+	inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+	{
+		acc ^= Round(0, value);
+		return acc * Prime1 + Prime4;
+	}
+
+	// Incremental hashing, for data that arrives in chunks.
+	class State
+	{
+	public:
+		explicit State(uint64_t seed = 0)
+			: m_acc { seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 }
+			, m_seed(seed)
+		{
+		}
+
+		void Update(const void *input, size_t size)
+		{
+			auto data = static_cast<const uint8_t *>(input);
+			m_totalSize += size;
+
+			if (m_bufferSize + size < sizeof(m_buffer))
+			{
+				std::memcpy(m_buffer + m_bufferSize, data, size);
+				m_bufferSize += size;
+				return;
+			}
+
+			if (m_bufferSize > 0)
+			{
+				const auto fill = sizeof(m_buffer) - m_bufferSize;
+				std::memcpy(m_buffer + m_bufferSize, data, fill);
+				ProcessStripe(m_buffer);
+				data += fill;
+				size -= fill;
+				m_bufferSize = 0;
+			}
+
+			for (; size >= sizeof(m_buffer); data += sizeof(m_buffer), size -= sizeof(m_buffer))
+				ProcessStripe(data);
+
+			std::memcpy(m_buffer, data, size);
+			m_bufferSize = size;
+		}
+
+		uint64_t Digest() const
+		{
+			uint64_t hash;
+			if (m_totalSize >= sizeof(m_buffer))
+			{
+				hash = RotateLeft(m_acc[0], 1) + RotateLeft(m_acc[1], 7) + RotateLeft(m_acc[2], 12) + RotateLeft(m_acc[3], 18);
+				for (const auto acc : m_acc)
+					hash = MergeRound(hash, acc);
+			}
+			else
+			{
+				hash = m_seed + Prime5;
+			}
+
+			hash += m_totalSize;
+
+			auto data = m_buffer;
+			auto size = m_bufferSize;
+			for (; size >= 8; data += 8, size -= 8)
+			{
+				hash ^= Round(0, endian::Load<false, uint64_t>(data));
+				hash = RotateLeft(hash, 27) * Prime1 + Prime4;
+			}
+			if (size >= 4)
+			{
+				hash ^= uint64_t(endian::Load<false, uint32_t>(data)) * Prime1;
+				hash = RotateLeft(hash, 23) * Prime2 + Prime3;
+				data += 4;
+				size -= 4;
+			}
+			for (; size > 0; data++, size--)
+			{
+				hash ^= *data * Prime5;
+				hash = RotateLeft(hash, 11) * Prime1;
+			}
+
+			hash ^= hash >> 33;
+			hash *= Prime2;
+			hash ^= hash >> 29;
+			hash *= Prime3;
+			hash ^= hash >> 32;
+			return hash;
+		}
+
+	private:
+		void ProcessStripe(const uint8_t *stripe)
+		{
+			for (auto i = 0; i < 4; i++)
+				m_acc[i] = Round(m_acc[i], endian::Load<false, uint64_t>(stripe + i * 8));
+		}
+
+		uint64_t m_acc[4];
+		uint64_t m_seed;
+		uint64_t m_totalSize = 0;
+		uint8_t m_buffer[32];
+		size_t m_bufferSize = 0;
+	};
+
+	inline uint64_t Hash(const void *data, size_t size, uint64_t seed = 0)
+	{
+		State state(seed);
+		state.Update(data, size);
+		return state.Digest();
+	}
+}
@@ -0,0 +1,418 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace libbndl;
+
+// Round trips a generated bundle through Load, GetData, AddResource, Save and Load again, checks
+// the result is byte for byte the same, and compares the wall time and peak memory against the
+// recorded baselines. The bundle is generated by a separate run (--generate), and each case runs
+// in its own process, so the peak memory is the round trip's alone. The wall time is recorded
+// relative to a fixed reference workload timed in the same process, so the baselines hold on
+// other machines too.
+
+namespace
+{
+	struct Case
+	{
+		const char *name;
+		Bundle::MagicVersion magicVersion;
+		uint32_t revisionNumber;
+		Bundle::Platform platform;
+		bool compressed;
+	};
+
+	// Save only writes PC BND2, and compressed BNDL needs revision 4 or later.
+	const Case Cases[] = {
+		{ "bnd2-pc", Bundle::BND2, 2, Bundle::PC, false },
+		{ "bnd2-pc-zlib", Bundle::BND2, 2, Bundle::PC, true },
+		{ "bndl3-pc", Bundle::BNDL, 3, Bundle::PC, false },
+		{ "bndl3-x360", Bundle::BNDL, 3, Bundle::Xbox360, false },
+		{ "bndl3-ps3", Bundle::BNDL, 3, Bundle::PS3, false },
+		{ "bndl5-pc", Bundle::BNDL, 5, Bundle::PC, false },
+		{ "bndl5-pc-zlib", Bundle::BNDL, 5, Bundle::PC, true },
+		{ "bndl5-x360", Bundle::BNDL, 5, Bundle::Xbox360, false },
+		{ "bndl5-x360-zlib", Bundle::BNDL, 5, Bundle::Xbox360, true },
+		{ "bndl5-ps3", Bundle::BNDL, 5, Bundle::PS3, false },
+		{ "bndl5-ps3-zlib", Bundle::BNDL, 5, Bundle::PS3, true },
+	};
+
+	struct Baseline
+	{
+		double relativeTime; // round trip time over reference time
+		uint64_t peakKilobytes;
+	};
+
+	uint64_t PeakKilobytes()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.PeakWorkingSetSize / 1024;
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#if defined(__APPLE__)
+		return static_cast<uint64_t>(usage.ru_maxrss) / 1024; // bytes on macOS
+#else
+		return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#endif
+	}
+
+	// Fills, copies and checksums a fixed buffer: the same kind of work as the round trip, but none
+	// of it in libbndl. The fastest of a few runs, to keep out the noise.
+	double ReferenceMilliseconds()
+	{
+		constexpr size_t BufferSize = 64 * 1024 * 1024;
+		constexpr auto Runs = 3;
+
+		auto fastest = 0.0;
+		for (auto run = 0; run < Runs; run++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			std::vector<uint8_t> source(BufferSize);
+			auto state = uint64_t(0x5EED);
+			for (size_t i = 0; i < source.size();)
+			{
+				auto z = (state += 0x9E3779B97F4A7C15ULL);
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+				const auto length = std::min<size_t>(1 + (z >> 58), source.size() - i);
+				std::fill_n(source.begin() + i, length, static_cast<uint8_t>(z));
+				i += length;
+			}
+			const auto copy = source;
+
+			// Adler-32, a byte at a time.
+			uint32_t a = 1;
+			uint32_t b = 0;
+			for (const auto byte : copy)
+			{
+				a = (a + byte) % 65521;
+				b = (b + a) % 65521;
+			}
+
+			const auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (run == 0 || milliseconds < fastest)
+				fastest = milliseconds;
+			// So the checksum isn't optimized away.
+			volatile auto checksum = (b << 16) | a;
+			(void)checksum;
+		}
+		return fastest;
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string &fileName)
+	{
+		std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
+
+	// One "<case> <relative time> <peak kilobytes>" line per case; # starts a comment.
+	std::map<std::string, Baseline> ReadBaselines(const std::string &fileName)
+	{
+		std::map<std::string, Baseline> baselines;
+		std::ifstream stream(fileName);
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream fields(line);
+			std::string name;
+			Baseline baseline;
+			if (fields >> name >> baseline.relativeTime >> baseline.peakKilobytes)
+				baselines[name] = baseline;
+		}
+		return baselines;
+	}
+
+	// Replaces the case's line, keeping everything else as it is.
+	bool WriteBaseline(const std::string &fileName, const std::string &caseName, const Baseline &baseline)
+	{
+		std::vector<std::string> lines;
+		{
+			std::ifstream stream(fileName);
+			std::string line;
+			while (std::getline(stream, line))
+			{
+				std::istringstream fields(line);
+				std::string name;
+				if (line.empty() || line[0] == '#' || !(fields >> name) || name != caseName)
+					lines.push_back(line);
+			}
+		}
+
+		char line[256];
+		std::snprintf(line, sizeof(line), "%s %.2f %llu", caseName.c_str(), baseline.relativeTime,
+			static_cast<unsigned long long>(baseline.peakKilobytes));
+		lines.push_back(line);
+
+		std::ofstream stream(fileName, std::ios::out | std::ios::trunc);
+		for (const auto &l : lines)
+			stream << l << '\n';
+		return !stream.fail();
+	}
+
+	class Stopwatch
+	{
+	public:
+		double Lap(const char *phase)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			const auto milliseconds = std::chrono::duration<double, std::milli>(now - m_last).count();
+			m_last = now;
+			std::printf("  %-10s %10.1f ms\n", phase, milliseconds);
+			return milliseconds;
+		}
+
+	private:
+		std::chrono::steady_clock::time_point m_last = std::chrono::steady_clock::now();
+	};
+
+	std::string GeneratedName(const Case &testCase, const std::filesystem::path &directory)
+	{
+		return (directory / (std::string("libbndl_perf_") + testCase.name + ".bundle")).string();
+	}
+
+	bool Generate(const Case &testCase, uint32_t resourceCount, const std::filesystem::path &directory)
+	{
+		GeneratorOptions options;
+		options.magicVersion = testCase.magicVersion;
+		options.revisionNumber = testCase.revisionNumber;
+		options.platform = testCase.platform;
+		options.compressed = testCase.compressed;
+		options.resourceCount = resourceCount;
+		options.seed = 0x5EED;
+		return GenerateBundle(options, GeneratedName(testCase, directory));
+	}
+
+	bool RoundTrip(const Case &testCase, const std::filesystem::path &directory, double &milliseconds, uint64_t &peakKilobytes)
+	{
+		const auto generatedName = GeneratedName(testCase, directory);
+		const auto rebuiltName = generatedName + ".rebuilt";
+
+		Stopwatch stopwatch;
+		milliseconds = 0.0;
+		{
+			Bundle loaded;
+			if (!loaded.Load(generatedName))
+			{
+				std::printf("Failed to load the generated bundle\n");
+				return false;
+			}
+			milliseconds += stopwatch.Lap("load");
+
+			Bundle rebuilt(loaded.GetMagicVersion(), loaded.GetRevisionNumber(), loaded.GetPlatform(), loaded.GetFlags());
+			for (const auto resourceID : loaded.GetResourceIDs())
+			{
+				auto data = loaded.GetData(resourceID);
+				if (!data || !rebuilt.AddResource(resourceID, std::move(*data), *loaded.GetResourceType(resourceID)))
+				{
+					std::printf("Failed to copy resource %08x\n", resourceID);
+					return false;
+				}
+
+				const auto debugInfo = loaded.GetDebugInfoView(resourceID);
+				if (debugInfo && !rebuilt.AddDebugInfo(resourceID, debugInfo->name, debugInfo->typeName))
+				{
+					std::printf("Failed to copy the debug info of %08x\n", resourceID);
+					return false;
+				}
+			}
+			milliseconds += stopwatch.Lap("rebuild");
+
+			if (!rebuilt.Save(rebuiltName))
+			{
+				std::printf("Failed to save the rebuilt bundle\n");
+				return false;
+			}
+			milliseconds += stopwatch.Lap("save");
+		}
+
+		Bundle reloaded;
+		if (!reloaded.Load(rebuiltName))
+		{
+			std::printf("Failed to load the rebuilt bundle\n");
+			return false;
+		}
+		const auto issues = reloaded.Verify();
+		milliseconds += stopwatch.Lap("reload");
+
+		// Before the files are read in to be compared.
+		peakKilobytes = PeakKilobytes();
+
+		for (const auto &issue : issues)
+			std::printf("%08x: %s\n", issue.resourceID, issue.message.c_str());
+		if (!issues.empty())
+			return false;
+
+		const auto generated = ReadFile(generatedName);
+		const auto rebuilt = ReadFile(rebuiltName);
+		if (generated.empty() || generated != rebuilt)
+		{
+			auto offset = size_t(0);
+			while (offset < generated.size() && offset < rebuilt.size() && generated[offset] == rebuilt[offset])
+				offset++;
+			std::printf("The rebuilt bundle differs from the generated one at offset 0x%zx (sizes %zu and %zu)\n", offset,
+				generated.size(), rebuilt.size());
+			return false;
+		}
+
+		std::filesystem::remove(rebuiltName);
+
+		return true;
+	}
+
+	void PrintUsage()
+	{
+		std::printf("Usage: libbndl_perf --case <name> --generate [--count <resources>] [--directory <dir>]\n"
+			"       libbndl_perf --case <name> [--baselines <file>] [--update] [--time-tolerance <fraction>]\n"
+			"                    [--memory-tolerance <fraction>] [--directory <dir>]\n"
+			"Cases:");
+		for (const auto &testCase : Cases)
+			std::printf(" %s", testCase.name);
+		std::printf("\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string caseName;
+	std::string baselinesName;
+	std::string directoryName;
+	auto generate = false;
+	auto update = false;
+	auto resourceCount = 2000U;
+	auto timeTolerance = 0.25;
+	auto memoryTolerance = 0.10;
+
+	for (auto i = 1; i < argc; i++)
+	{
+		const auto hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--case") == 0 && hasValue)
+			caseName = argv[++i];
+		else if (std::strcmp(argv[i], "--baselines") == 0 && hasValue)
+			baselinesName = argv[++i];
+		else if (std::strcmp(argv[i], "--directory") == 0 && hasValue)
+			directoryName = argv[++i];
+		else if (std::strcmp(argv[i], "--count") == 0 && hasValue)
+			resourceCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--time-tolerance") == 0 && hasValue)
+			timeTolerance = std::strtod(argv[++i], nullptr);
+		else if (std::strcmp(argv[i], "--memory-tolerance") == 0 && hasValue)
+			memoryTolerance = std::strtod(argv[++i], nullptr);
+		else if (std::strcmp(argv[i], "--generate") == 0)
+			generate = true;
+		else if (std::strcmp(argv[i], "--update") == 0)
+			update = true;
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	const Case *testCase = nullptr;
+	for (const auto &c : Cases)
+	{
+		if (caseName == c.name)
+			testCase = &c;
+	}
+	if (testCase == nullptr)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	const auto directory = std::filesystem::path(directoryName.empty() ? "." : directoryName);
+	if (!std::filesystem::is_directory(directory))
+	{
+		std::printf("%s is not a directory\n", directory.string().c_str());
+		return EXIT_FAILURE;
+	}
+
+	if (generate)
+	{
+		if (!Generate(*testCase, resourceCount, directory))
+		{
+			std::printf("Failed to generate the %s bundle\n", testCase->name);
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	std::printf("%s\n", testCase->name);
+	auto milliseconds = 0.0;
+	Baseline measured;
+	if (!RoundTrip(*testCase, directory, milliseconds, measured.peakKilobytes))
+		return EXIT_FAILURE;
+
+	// After the round trip, so it doesn't add to the peak memory.
+	const auto referenceMilliseconds = ReferenceMilliseconds();
+	measured.relativeTime = milliseconds / referenceMilliseconds;
+	std::printf("  %-10s %10.1f ms\n  %-10s %10.1f ms\n  %-10s %10.2f\n  %-10s %10llu KiB\n", "total", milliseconds,
+		"reference", referenceMilliseconds, "relative", measured.relativeTime, "peak", static_cast<unsigned long long>(measured.peakKilobytes));
+
+	if (baselinesName.empty())
+		return EXIT_SUCCESS;
+
+	if (update)
+	{
+		if (!WriteBaseline(baselinesName, testCase->name, measured))
+		{
+			std::printf("Failed to write %s\n", baselinesName.c_str());
+			return EXIT_FAILURE;
+		}
+		std::printf("Baseline updated\n");
+		return EXIT_SUCCESS;
+	}
+
+	const auto baselines = ReadBaselines(baselinesName);
+	const auto it = baselines.find(testCase->name);
+	if (it == baselines.end())
+	{
+		std::printf("No baseline for %s; record one with --update\n", testCase->name);
+		return EXIT_SUCCESS;
+	}
+
+	const auto &baseline = it->second;
+	auto passed = true;
+	if (measured.relativeTime > baseline.relativeTime * (1.0 + timeTolerance))
+	{
+		std::printf("Slower than the baseline: %.2f times the reference, allowed %.2f\n", measured.relativeTime, baseline.relativeTime * (1.0 + timeTolerance));
+		passed = false;
+	}
+	if (measured.peakKilobytes > baseline.peakKilobytes * (1.0 + memoryTolerance))
+	{
+		std::printf("More memory than the baseline: %llu KiB, allowed %.0f KiB\n", static_cast<unsigned long long>(measured.peakKilobytes),
+			baseline.peakKilobytes * (1.0 + memoryTolerance));
+		passed = false;
+	}
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
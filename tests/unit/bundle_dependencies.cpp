@@ -0,0 +1,83 @@
+#include <libbndl/bundle.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace libbndl;
+
+// BND2 keeps a resource's dependencies at the end of its first block. Adding a resource and
+// reading it back, through a saved file on PC and in memory on a big-endian platform, gives back
+// the same data and dependencies. Transitive dependencies leave out the resource asked about,
+// even in a cycle.
+
+namespace
+{
+	constexpr auto FileName = "bundle_dependencies.bundle";
+	constexpr auto ResourceID = 0x12345678U;
+
+	bool Check(bool condition, const char *what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	Bundle::EntryData MakeData()
+	{
+		Bundle::EntryData data;
+		// Not a multiple of 16, so any padding before the dependencies would show.
+		data.fileBlockData[0] = std::make_unique<std::vector<uint8_t>>(std::vector<uint8_t>{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 });
+		data.alignments[0] = 16;
+		data.alignments[1] = 128;
+		data.alignments[2] = 128;
+		data.dependencies = { { 0x0BADF00D, 4 }, { 0xCAFEBABE, 8 } };
+		return data;
+	}
+
+	bool Matches(const Bundle &bundle, const char *what)
+	{
+		const auto expected = MakeData();
+		const auto data = bundle.GetData(ResourceID);
+		if (!Check(data.has_value() && data->fileBlockData[0] != nullptr, what))
+			return false;
+
+		auto matches = Check(*data->fileBlockData[0] == *expected.fileBlockData[0], "data before the dependencies");
+		matches = Check(data->dependencies.size() == expected.dependencies.size(), "dependency count") && matches;
+		for (size_t i = 0; matches && i < expected.dependencies.size(); i++)
+		{
+			matches = Check(data->dependencies[i].resourceID == expected.dependencies[i].resourceID
+				&& data->dependencies[i].internalOffset == expected.dependencies[i].internalOffset, "dependency") && matches;
+		}
+		return matches;
+	}
+}
+
+int main()
+{
+	const auto flags = static_cast<Bundle::Flags>(Bundle::Compressed | Bundle::UnusedFlag1 | Bundle::UnusedFlag2);
+
+	Bundle pc(Bundle::BND2, 2, Bundle::PC, flags);
+	auto passed = Check(pc.AddResource(ResourceID, MakeData(), Bundle::Raster), "adding to a PC bundle");
+	passed = Matches(pc, "reading back from a PC bundle") && passed;
+
+	Bundle loaded;
+	passed = Check(pc.Save(FileName) && loaded.Load(FileName), "saving and loading a PC bundle") && passed;
+	passed = Matches(loaded, "reading back from a saved PC bundle") && passed;
+	passed = Check(loaded.GetDependencies(ResourceID).size() == 2, "dependencies of a saved PC bundle") && passed;
+
+	// Big-endian BND2 can't be saved, but the dependencies have to come back in memory.
+	Bundle xbox(Bundle::BND2, 2, Bundle::Xbox360, flags);
+	passed = Check(xbox.AddResource(ResourceID, MakeData(), Bundle::Raster), "adding to an Xbox 360 bundle") && passed;
+	passed = Matches(xbox, "reading back from an Xbox 360 bundle") && passed;
+
+	// ResourceID -> 0x0BADF00D -> ResourceID, and on to 0xCAFEBABE.
+	auto cycle = MakeData();
+	cycle.dependencies = { { ResourceID, 0 } };
+	passed = Check(pc.AddResource(0x0BADF00D, cycle, Bundle::Raster), "adding a resource in a cycle") && passed;
+	const auto transitive = pc.GetTransitiveDependencies(ResourceID);
+	passed = Check(transitive == std::vector<uint32_t>{ 0x0BADF00D, 0xCAFEBABE }, "transitive dependencies in a cycle") && passed;
+
+	std::remove(FileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
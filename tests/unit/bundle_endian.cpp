@@ -0,0 +1,123 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace libbndl;
+
+// Generates the same BNDL bundle for PC and for the big-endian Xbox 360 and PS3, and checks the
+// console bundles are stored big endian, read back the same as the PC one, and save byte for byte
+// as they were loaded.
+
+namespace
+{
+	constexpr auto PCFileName = "bundle_endian_pc.bundle";
+	constexpr auto ConsoleFileName = "bundle_endian_console.bundle";
+	constexpr auto SavedFileName = "bundle_endian_saved.bundle";
+
+	bool Check(bool condition, const std::string &what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string &fileName)
+	{
+		std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
+
+	bool SameDependencies(const std::vector<Bundle::Dependency> &a, const std::vector<Bundle::Dependency> &b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].resourceID != b[i].resourceID || a[i].internalOffset != b[i].internalOffset)
+				return false;
+		}
+		return true;
+	}
+
+	bool Matches(const Bundle &bundle, const Bundle &expected, const std::string &what)
+	{
+		if (!Check(bundle.ListResourceIDs() == expected.ListResourceIDs(), what + ": resource IDs"))
+			return false;
+
+		auto matches = true;
+		for (const auto resourceID : expected.GetResourceIDs())
+		{
+			for (auto i = 0U; i < 3 && matches; i++)
+			{
+				const auto data = bundle.GetBinary(resourceID, i);
+				const auto expectedData = expected.GetBinary(resourceID, i);
+				matches = Check((data == nullptr) == (expectedData == nullptr) && (data == nullptr || *data == *expectedData), what + ": data");
+			}
+			matches = matches && Check(bundle.GetResourceType(resourceID) == expected.GetResourceType(resourceID), what + ": resource type");
+			matches = matches && Check(SameDependencies(bundle.GetDependencies(resourceID), expected.GetDependencies(resourceID)), what + ": dependencies");
+			// Save leaves the string table out of compressed BNDL bundles.
+			const auto debugInfo = bundle.GetDebugInfoView(resourceID);
+			const auto expectedDebugInfo = expected.GetDebugInfoView(resourceID);
+			matches = matches && Check((bundle.GetFlags() & Bundle::Compressed) ? !debugInfo.has_value() && !expectedDebugInfo.has_value()
+				: debugInfo.has_value() && expectedDebugInfo.has_value() && debugInfo->name == expectedDebugInfo->name && debugInfo->typeName == expectedDebugInfo->typeName,
+				what + ": debug info");
+			if (!matches)
+				break;
+		}
+		return matches;
+	}
+
+	bool RoundTrip(uint32_t revisionNumber, bool compressed, Bundle::Platform platform, const std::string &what)
+	{
+		GeneratorOptions options;
+		options.magicVersion = Bundle::BNDL;
+		options.revisionNumber = revisionNumber;
+		options.compressed = compressed;
+		options.resourceCount = 100;
+		options.dependencyDensity = 2.0;
+		options.seed = revisionNumber;
+
+		auto consoleOptions = options;
+		consoleOptions.platform = platform;
+		if (!Check(GenerateBundle(options, PCFileName) && GenerateBundle(consoleOptions, ConsoleFileName), what + ": generating"))
+			return false;
+
+		// The revision number right after the magic is the first big-endian field.
+		const auto file = ReadFile(ConsoleFileName);
+		auto passed = Check(file.size() > 8 && file[4] == 0 && file[5] == 0 && file[6] == 0 && file[7] == revisionNumber, what + ": big-endian header");
+
+		Bundle pc;
+		Bundle console;
+		if (!Check(pc.Load(PCFileName) && console.Load(ConsoleFileName), what + ": loading"))
+			return false;
+		passed = Check(console.GetPlatform() == platform && console.GetRevisionNumber() == revisionNumber, what + ": header fields") && passed;
+		passed = Check(console.Verify().empty(), what + ": verifying") && passed;
+		passed = Matches(console, pc, what) && passed;
+
+		passed = Check(console.Save(SavedFileName) && ReadFile(SavedFileName) == file, what + ": saving unchanged") && passed;
+		return passed;
+	}
+}
+
+int main()
+{
+	auto passed = true;
+	for (const auto platform : { Bundle::Xbox360, Bundle::PS3 })
+	{
+		const auto platformName = std::string(platform == Bundle::Xbox360 ? "Xbox 360" : "PS3");
+		passed = RoundTrip(3, false, platform, platformName + " revision 3") && passed;
+		passed = RoundTrip(5, false, platform, platformName + " revision 5") && passed;
+		passed = RoundTrip(5, true, platform, platformName + " revision 5 compressed") && passed;
+	}
+
+	std::remove(PCFileName);
+	std::remove(ConsoleFileName);
+	std::remove(SavedFileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
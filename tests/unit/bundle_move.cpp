@@ -0,0 +1,89 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+using namespace libbndl;
+
+// Moves a loaded bundle into a container and between variables, and checks the data, the lazily
+// read dependencies and debug info, and the statistics all come along, and that the bundles moved
+// from stay usable.
+
+static_assert(std::is_move_constructible_v<Bundle>);
+static_assert(std::is_move_assignable_v<Bundle>);
+
+namespace
+{
+	constexpr auto FileName = "bundle_move.bundle";
+
+	bool Check(bool condition, const char *what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	bool Matches(const Bundle &bundle, const Bundle &expected)
+	{
+		auto matches = Check(bundle.ListResourceIDs() == expected.ListResourceIDs(), "resource IDs");
+		for (const auto resourceID : expected.GetResourceIDs())
+		{
+			for (auto i = 0U; i < 3; i++)
+			{
+				const auto data = bundle.GetBinary(resourceID, i);
+				const auto expectedData = expected.GetBinary(resourceID, i);
+				matches = matches && Check((data == nullptr) == (expectedData == nullptr) && (data == nullptr || *data == *expectedData), "data");
+			}
+			matches = matches && Check(bundle.GetDependencies(resourceID).size() == expected.GetDependencies(resourceID).size(), "dependencies");
+			const auto debugInfo = bundle.GetDebugInfo(resourceID);
+			const auto expectedDebugInfo = expected.GetDebugInfo(resourceID);
+			matches = matches && Check(debugInfo.has_value() && expectedDebugInfo.has_value()
+				&& debugInfo->name == expectedDebugInfo->name && debugInfo->typeName == expectedDebugInfo->typeName, "debug info");
+		}
+		return matches;
+	}
+}
+
+int main()
+{
+	GeneratorOptions options;
+	options.resourceCount = 200;
+	options.compressed = true;
+	options.dependencyDensity = 2.0;
+	if (!Check(GenerateBundle(options, FileName), "generating the bundle"))
+		return EXIT_FAILURE;
+
+	Bundle expected;
+	Bundle loaded;
+	if (!Check(expected.Load(FileName) && loaded.Load(FileName), "loading the bundle"))
+		return EXIT_FAILURE;
+	const auto bytesRead = loaded.GetStatistics().bytesRead;
+
+	// Dependencies and debug info are still unread, so their pending state has to move too.
+	std::vector<Bundle> bundles;
+	bundles.push_back(std::move(loaded));
+	auto passed = Check(bundles[0].GetStatistics().bytesRead == bytesRead, "statistics after move construction");
+	passed = Matches(bundles[0], expected) && passed;
+
+	// The source is left empty, and can be queried and loaded again.
+	passed = Check(loaded.ListResourceIDs().empty() && loaded.GetStatistics().bytesRead == 0, "moved-from bundle is empty") && passed;
+	passed = Check(!loaded.GetDebugInfo(*expected.GetResourceIDs().begin()).has_value()
+		&& loaded.GetDependencies(*expected.GetResourceIDs().begin()).empty(), "queries on a moved-from bundle") && passed;
+	passed = Check(loaded.Load(FileName), "loading a moved-from bundle") && passed;
+	passed = Matches(loaded, expected) && passed;
+
+	Bundle assigned;
+	assigned = std::move(bundles[0]);
+	passed = Matches(assigned, expected) && passed;
+
+	// Assigning over a loaded bundle, and saving the bundle that was moved from.
+	loaded = std::move(assigned);
+	passed = Matches(loaded, expected) && passed;
+	passed = Check(bundles[0].Save(FileName) && assigned.ListResourceIDs().empty(), "saving a moved-from bundle") && passed;
+
+	std::remove(FileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,123 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/bundle_patch.hpp>
+#include <libbndl/generator.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace libbndl;
+
+// Makes a patch between two versions of a bundle, takes it through a file, and checks applying it
+// reproduces the new version byte for byte, both ways, and that it refuses any other bundle
+// without changing it.
+
+namespace
+{
+	constexpr auto FromFileName = "bundle_patch_from.bundle";
+	constexpr auto ToFileName = "bundle_patch_to.bundle";
+	constexpr auto PatchedFileName = "bundle_patch_patched.bundle";
+	constexpr auto OtherFileName = "bundle_patch_other.bundle";
+	constexpr auto PatchFileName = "bundle_patch.patch";
+
+	bool Check(bool condition, const std::string &what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string &fileName)
+	{
+		std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
+
+	// Creates the patch between the two files, saves and loads it, and applies it to from.
+	bool RoundTrip(const std::string &fromFileName, const std::string &toFileName, size_t changed, size_t removed, const std::string &what)
+	{
+		Bundle from;
+		Bundle to;
+		BundlePatch created;
+		if (!Check(from.Load(fromFileName) && to.Load(toFileName) && created.Create(from, to), what + ": creating"))
+			return false;
+		auto passed = Check(created.GetChangedResources().size() == changed && created.GetRemovedResources().size() == removed, what + ": changes");
+
+		BundlePatch loaded;
+		passed = Check(created.Save(PatchFileName) && loaded.Load(PatchFileName), what + ": saving and loading") && passed;
+		passed = Check(loaded.GetChangedResources() == created.GetChangedResources() && loaded.GetRemovedResources() == created.GetRemovedResources(),
+			what + ": loaded changes") && passed;
+
+		Bundle patched;
+		passed = Check(patched.Load(fromFileName) && loaded.Apply(patched), what + ": applying") && passed;
+		passed = Check(patched.Save(PatchedFileName) && ReadFile(PatchedFileName) == ReadFile(toFileName), what + ": same as the new version") && passed;
+
+		// Neither the new version nor the patched bundle is what the patch was made from.
+		passed = Check(!loaded.Apply(patched), what + ": applying twice") && passed;
+		passed = Check(patched.Save(PatchedFileName) && ReadFile(PatchedFileName) == ReadFile(toFileName), what + ": unchanged by a refused patch") && passed;
+		return passed;
+	}
+}
+
+int main()
+{
+	GeneratorOptions options;
+	options.resourceCount = 200;
+	options.compressed = true;
+	options.seed = 1;
+	if (!Check(GenerateBundle(options, FromFileName), "generating"))
+		return EXIT_FAILURE;
+
+	// The new version replaces 20 resources and adds 10 with debug info. The generator names
+	// resources by index, so the added ones need names of their own.
+	auto replacementOptions = options;
+	replacementOptions.resourceCount = 30;
+	replacementOptions.seed = 2;
+	replacementOptions.dependencyDensity = 0.0;
+	const auto replacements = GenerateBundle(replacementOptions);
+	Bundle to;
+	if (!Check(replacements != nullptr && to.Load(FromFileName), "loading"))
+		return EXIT_FAILURE;
+
+	const auto resourceIDs = to.ListResourceIDs();
+	const auto replacementIDs = replacements->ListResourceIDs();
+	auto passed = true;
+	for (auto i = 0U; i < 20; i++)
+		passed = Check(to.ReplaceResource(resourceIDs[i * 10], *replacements->GetData(replacementIDs[i])), "replacing") && passed;
+	for (auto i = 20U; i < 30; i++)
+	{
+		const auto name = "added/" + std::to_string(i);
+		const auto resourceType = *replacements->GetResourceType(replacementIDs[i]);
+		passed = Check(to.AddResource(name, *replacements->GetData(replacementIDs[i]), resourceType)
+			&& to.AddDebugInfo(name, name, Bundle::GetResourceTypeName(resourceType)), "adding") && passed;
+	}
+	passed = Check(to.Save(ToFileName), "saving the new version") && passed;
+
+	passed = RoundTrip(FromFileName, ToFileName, 30, 0, "forwards") && passed;
+	passed = RoundTrip(ToFileName, FromFileName, 20, 10, "backwards") && passed;
+
+	// A bundle of the same format with different contents is refused too. The patch file holds
+	// the backwards patch now.
+	auto otherOptions = options;
+	otherOptions.seed = 3;
+	Bundle other;
+	BundlePatch patch;
+	passed = Check(GenerateBundle(otherOptions, OtherFileName) && patch.Load(PatchFileName) && other.Load(OtherFileName) && !patch.Apply(other),
+		"applying to another bundle") && passed;
+	passed = Check(other.Save(PatchedFileName) && ReadFile(PatchedFileName) == ReadFile(OtherFileName), "other bundle unchanged") && passed;
+
+	// A truncated patch doesn't load.
+	std::filesystem::resize_file(PatchFileName, std::filesystem::file_size(PatchFileName) / 2);
+	passed = Check(!BundlePatch().Load(PatchFileName), "loading a truncated patch") && passed;
+
+	std::remove(FromFileName);
+	std::remove(ToFileName);
+	std::remove(PatchedFileName);
+	std::remove(OtherFileName);
+	std::remove(PatchFileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
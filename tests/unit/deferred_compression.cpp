@@ -0,0 +1,109 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace libbndl;
+
+// Copies a generated bundle into a compressed one with deferred compression, and checks nothing
+// is compressed until CompressDeferredBlocks or Save, the data reads back the same before and
+// after, and the saved file is the same as with compression on every add.
+
+namespace
+{
+	constexpr auto SourceFileName = "deferred_compression_source.bundle";
+	constexpr auto DeferredFileName = "deferred_compression_deferred.bundle";
+	constexpr auto ImmediateFileName = "deferred_compression_immediate.bundle";
+
+	bool Check(bool condition, const std::string &what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string &fileName)
+	{
+		std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
+
+	bool Copy(const Bundle &source, Bundle &target, const std::vector<uint32_t> &resourceIDs)
+	{
+		for (const auto resourceID : resourceIDs)
+		{
+			auto data = source.GetData(resourceID);
+			if (!data || !target.AddResource(resourceID, std::move(*data), *source.GetResourceType(resourceID)))
+				return false;
+		}
+		return true;
+	}
+
+	// The resources in bundle have the same data as in expected.
+	bool Matches(const Bundle &bundle, const Bundle &expected, const std::string &what)
+	{
+		for (const auto resourceID : bundle.GetResourceIDs())
+		{
+			for (auto i = 0U; i < 3; i++)
+			{
+				const auto data = bundle.GetBinary(resourceID, i);
+				const auto expectedData = expected.GetBinary(resourceID, i);
+				if (!Check((data == nullptr) == (expectedData == nullptr) && (data == nullptr || *data == *expectedData), what))
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main()
+{
+	GeneratorOptions options;
+	options.resourceCount = 200;
+	options.resourceStringTable = false;
+	Bundle source;
+	if (!Check(GenerateBundle(options, SourceFileName) && source.Load(SourceFileName), "generating the source bundle"))
+		return EXIT_FAILURE;
+
+	const auto resourceIDs = source.ListResourceIDs();
+	const auto half = std::vector<uint32_t>(resourceIDs.begin(), resourceIDs.begin() + resourceIDs.size() / 2);
+	const auto rest = std::vector<uint32_t>(resourceIDs.begin() + resourceIDs.size() / 2, resourceIDs.end());
+	const auto flags = static_cast<Bundle::Flags>(source.GetFlags() | Bundle::Compressed);
+
+	Bundle immediate(source.GetMagicVersion(), source.GetRevisionNumber(), source.GetPlatform(), flags);
+	auto passed = Check(Copy(source, immediate, resourceIDs), "adding with immediate compression");
+	passed = Check(immediate.GetStatistics().bytesDeflated > 0, "compressing on add") && passed;
+	passed = Check(immediate.Save(ImmediateFileName), "saving with immediate compression") && passed;
+
+	Bundle deferred(source.GetMagicVersion(), source.GetRevisionNumber(), source.GetPlatform(), flags);
+	deferred.SetDeferredCompression(true);
+	passed = Check(Copy(source, deferred, half), "adding with deferred compression") && passed;
+	passed = Check(deferred.GetStatistics().bytesDeflated == 0, "nothing compressed on add") && passed;
+	passed = Matches(deferred, source, "reading deferred blocks") && passed;
+
+	// Compressing the first half early leaves the second half for Save.
+	passed = Check(deferred.CompressDeferredBlocks(), "compressing the deferred blocks") && passed;
+	const auto halfDeflated = deferred.GetStatistics().bytesDeflated;
+	passed = Check(halfDeflated > 0, "compressing the first half") && passed;
+	passed = Check(Copy(source, deferred, rest) && deferred.GetStatistics().bytesDeflated == halfDeflated, "adding the second half") && passed;
+
+	passed = Check(deferred.Save(DeferredFileName), "saving with deferred compression") && passed;
+	passed = Check(deferred.GetStatistics().bytesDeflated == immediate.GetStatistics().bytesDeflated, "compressing every block once") && passed;
+	passed = Check(deferred.ListResourceIDs() == resourceIDs, "all resources added") && passed;
+	passed = Matches(deferred, source, "reading after Save") && passed;
+	passed = Check(ReadFile(DeferredFileName) == ReadFile(ImmediateFileName), "same file as immediate compression") && passed;
+
+	Bundle reloaded;
+	passed = Check(reloaded.Load(DeferredFileName) && reloaded.ListResourceIDs() == resourceIDs, "loading the saved bundle") && passed;
+	passed = Matches(reloaded, source, "reading the saved bundle") && passed;
+
+	std::remove(SourceFileName);
+	std::remove(DeferredFileName);
+	std::remove(ImmediateFileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,72 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+using namespace libbndl;
+
+// Options the formats can't represent are rejected before anything is generated, and compressed
+// bundles come back with every batch already compressed.
+
+namespace
+{
+	constexpr auto FileName = "generator_limits.bundle";
+
+	bool Check(bool condition, const char *what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+}
+
+int main()
+{
+	// The BND2 ID block keeps the alignment in the top 4 bits of the size, so blocks stay under 256 MiB.
+	GeneratorOptions blockTooLarge;
+	blockTooLarge.maxBlockSizes[1] = 1U << 28;
+	auto passed = Check(GenerateBundle(blockTooLarge) == nullptr, "rejecting a 256 MiB block");
+	passed = Check(!GenerateBundle(blockTooLarge, FileName) && !std::filesystem::exists(FileName), "rejecting a 256 MiB block for a file") && passed;
+
+	GeneratorOptions inverted;
+	inverted.minBlockSizes[0] = inverted.maxBlockSizes[0] + 1;
+	passed = Check(GenerateBundle(inverted) == nullptr, "rejecting a minimum above the maximum") && passed;
+
+	GeneratorOptions consoleBND2;
+	consoleBND2.platform = Bundle::Xbox360;
+	passed = Check(GenerateBundle(consoleBND2) == nullptr, "rejecting a console BND2") && passed;
+
+	GeneratorOptions compressedRevision3;
+	compressedRevision3.magicVersion = Bundle::BNDL;
+	compressedRevision3.revisionNumber = 3;
+	compressedRevision3.compressed = true;
+	passed = Check(GenerateBundle(compressedRevision3) == nullptr, "rejecting a compressed BNDL revision 3") && passed;
+
+	GeneratorOptions small;
+	small.resourceCount = 100;
+	passed = Check(GenerateBundle(small, FileName), "generating a small bundle") && passed;
+
+	// More than one batch, and all of it went through compression before Save.
+	GeneratorOptions compressed;
+	compressed.resourceCount = 5000;
+	compressed.compressed = true;
+	compressed.maxBlockSizes[0] = 256;
+	compressed.maxBlockSizes[1] = 256;
+	compressed.maxBlockSizes[2] = 256;
+	const auto bundle = GenerateBundle(compressed);
+	if (Check(bundle != nullptr, "generating a compressed bundle"))
+	{
+		uint64_t uncompressedSize = 0;
+		for (const auto resourceID : bundle->GetResourceIDs())
+		{
+			for (auto i = 0U; i < 3; i++)
+				uncompressedSize += bundle->GetUncompressedSize(resourceID, i).value_or(0);
+		}
+		passed = Check(uncompressedSize > 0 && bundle->GetStatistics().bytesDeflated == uncompressedSize, "compressing every batch") && passed;
+	}
+
+	std::remove(FileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,107 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace libbndl;
+
+// Loads generated bundles with resource types and file blocks filtered out, and checks exactly the
+// filtered data is left unread: the bytes read drop by its size, it has no data, but its metadata
+// is still there and the rest of the data is the same as in a full load.
+
+namespace
+{
+	constexpr auto FileName = "load_filter.bundle";
+
+	bool Check(bool condition, const std::string &what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	bool Wanted(const Bundle::LoadOptions &options, Bundle::ResourceType resourceType, uint32_t fileBlock)
+	{
+		const auto listed = std::find(options.resourceTypes.begin(), options.resourceTypes.end(), resourceType) != options.resourceTypes.end();
+		return options.fileBlocks[fileBlock] && listed != options.denyResourceTypes;
+	}
+
+	bool LoadFiltered(const Bundle &full, const Bundle::LoadOptions &options, const std::string &what)
+	{
+		Bundle filtered;
+		if (!Check(filtered.Load(FileName, options), what + ": loading"))
+			return false;
+
+		// Uncompressed, so the stored size of a block is its uncompressed size.
+		uint64_t skippedBytes = 0;
+		auto passed = Check(filtered.ListResourceIDs() == full.ListResourceIDs(), what + ": resource IDs");
+		for (const auto resourceID : full.GetResourceIDs())
+		{
+			const auto resourceType = *full.GetResourceType(resourceID);
+			passed = passed && Check(filtered.GetResourceType(resourceID) == resourceType, what + ": resource type");
+			for (auto i = 0U; i < 3 && passed; i++)
+			{
+				const auto size = *full.GetUncompressedSize(resourceID, i);
+				passed = Check(filtered.GetUncompressedSize(resourceID, i) == size, what + ": uncompressed size");
+
+				const auto data = filtered.GetBinary(resourceID, i);
+				if (Wanted(options, resourceType, i))
+				{
+					const auto expected = full.GetBinary(resourceID, i);
+					passed = passed && Check((data == nullptr) == (expected == nullptr) && (data == nullptr || *data == *expected), what + ": data");
+				}
+				else
+				{
+					passed = passed && Check(data == nullptr, what + ": filtered data");
+					skippedBytes += size;
+				}
+			}
+			if (!passed)
+				break;
+		}
+
+		passed = Check(skippedBytes > 0, what + ": something filtered") && passed;
+		passed = Check(filtered.GetStatistics().bytesRead + skippedBytes == full.GetStatistics().bytesRead, what + ": bytes read") && passed;
+		return passed;
+	}
+
+	bool TestFormat(Bundle::MagicVersion magicVersion, Bundle::Platform platform, const std::string &what)
+	{
+		GeneratorOptions generatorOptions;
+		generatorOptions.magicVersion = magicVersion;
+		generatorOptions.platform = platform;
+		generatorOptions.resourceCount = 200;
+		// No dependencies, since BND2 keeps them in block 0.
+		generatorOptions.dependencyDensity = 0.0;
+		Bundle full;
+		if (!Check(GenerateBundle(generatorOptions, FileName) && full.Load(FileName), what + ": generating"))
+			return false;
+
+		Bundle::LoadOptions denyRasters;
+		denyRasters.resourceTypes = { Bundle::Raster };
+		auto passed = LoadFiltered(full, denyRasters, what + " without rasters");
+
+		Bundle::LoadOptions onlyMaterials;
+		onlyMaterials.resourceTypes = { Bundle::Material, Bundle::Renderable };
+		onlyMaterials.denyResourceTypes = false;
+		passed = LoadFiltered(full, onlyMaterials, what + " with only materials and renderables") && passed;
+
+		Bundle::LoadOptions noSecondBlock;
+		noSecondBlock.fileBlocks[1] = false;
+		passed = LoadFiltered(full, noSecondBlock, what + " without block 1") && passed;
+
+		return passed;
+	}
+}
+
+int main()
+{
+	auto passed = TestFormat(Bundle::BND2, Bundle::PC, "BND2");
+	passed = TestFormat(Bundle::BNDL, Bundle::Xbox360, "BNDL Xbox 360") && passed;
+
+	std::remove(FileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
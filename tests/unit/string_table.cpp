@@ -0,0 +1,123 @@
+#include <libbndl/bundle.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace libbndl;
+
+// Loads BNDL bundles whose resource string table is written by hand, and checks what the scanner
+// makes of odd but valid XML, missing attributes, truncated tables and a wrong length prefix.
+
+namespace
+{
+	constexpr auto FileName = "string_table.bundle";
+	constexpr auto ResourceStringTableID = 0xC039284AU;
+
+	bool Check(bool condition, const std::string &what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	// BNDL keeps the table as a resource of its own: a little-endian length, then the XML.
+	std::vector<uint8_t> MakeTable(std::string_view xml, uint32_t length)
+	{
+		std::vector<uint8_t> table(4 + xml.size());
+		for (auto i = 0; i < 4; i++)
+			table[i] = static_cast<uint8_t>(length >> (i * 8));
+		std::memcpy(table.data() + 4, xml.data(), xml.size());
+		return table;
+	}
+
+	std::vector<uint8_t> MakeTable(std::string_view xml)
+	{
+		return MakeTable(xml, static_cast<uint32_t>(xml.size()));
+	}
+
+	// Saves the table as the string table resource, so Load finds it where Save would put it.
+	bool Load(const std::vector<uint8_t> &table, Bundle &bundle)
+	{
+		Bundle written(Bundle::BNDL, 5, Bundle::PC, static_cast<Bundle::Flags>(Bundle::UnusedFlag1 | Bundle::UnusedFlag2));
+		Bundle::EntryData data;
+		data.fileBlockData[0] = std::make_unique<std::vector<uint8_t>>(table);
+		data.alignments[0] = 4;
+		data.alignments[1] = 1;
+		data.alignments[2] = 1;
+		return written.AddResource(ResourceStringTableID, std::move(data), Bundle::TextFile) && written.Save(FileName) && bundle.Load(FileName);
+	}
+
+	bool HasDebugInfo(const Bundle &bundle, uint32_t resourceID, std::string_view name, std::string_view typeName)
+	{
+		const auto debugInfo = bundle.GetDebugInfoView(resourceID);
+		return debugInfo.has_value() && debugInfo->name == name && debugInfo->typeName == typeName;
+	}
+}
+
+int main()
+{
+	auto passed = true;
+
+	// Entities are left as they are, attributes can come in any order with either quote and any
+	// whitespace, and the table's own element isn't mistaken for a resource.
+	{
+		Bundle bundle;
+		passed = Check(Load(MakeTable("<ResourceStringTable>\n"
+			"\t<Resource id=\"00000001\" type=\"Raster\" name=\"a&amp;b &lt;c&gt; &quot;d&quot;\"/>\n"
+			"\t<Resource\n\t\tname='two'  type = 'Texture' id='0x0000000A' />\n"
+			"</ResourceStringTable>\n"), bundle), "loading escaped entities") && passed;
+		passed = Check(HasDebugInfo(bundle, 1, "a&amp;b &lt;c&gt; &quot;d&quot;", "Raster"), "entities left as they are") && passed;
+		passed = Check(HasDebugInfo(bundle, 0xA, "two", "Texture"), "attribute order, quotes and whitespace") && passed;
+		passed = Check(bundle.ListResourceIDs().empty(), "no resource for the string table") && passed;
+	}
+
+	// Without an id there's nothing to attach the rest to; a missing name or type is empty.
+	{
+		Bundle bundle;
+		passed = Check(Load(MakeTable("<ResourceStringTable>\n"
+			"\t<Resource type=\"Raster\" name=\"no id\"/>\n"
+			"\t<Resource id=\"00000002\" type=\"Raster\"/>\n"
+			"\t<Resource id=\"00000003\" name=\"no type\"/>\n"
+			"\t<Resource id=\"not hex\" type=\"Raster\" name=\"bad id\"/>\n"
+			"</ResourceStringTable>\n"), bundle), "loading missing attributes") && passed;
+		passed = Check(HasDebugInfo(bundle, 2, "", "Raster"), "missing name") && passed;
+		passed = Check(HasDebugInfo(bundle, 3, "no type", ""), "missing type") && passed;
+		passed = Check(!bundle.GetDebugInfoView(0).has_value(), "missing or invalid id") && passed;
+	}
+
+	// A table cut off in the middle of an element keeps everything before it.
+	{
+		Bundle bundle;
+		passed = Check(Load(MakeTable("<ResourceStringTable>\n"
+			"\t<Resource id=\"00000004\" type=\"Raster\" name=\"whole\"/>\n"
+			"\t<Resource id=\"00000005\" type=\"Raster\" name=\"cut of"), bundle), "loading truncated XML") && passed;
+		passed = Check(HasDebugInfo(bundle, 4, "whole", "Raster"), "entries before the truncation") && passed;
+		passed = Check(!bundle.GetDebugInfoView(5).has_value(), "truncated entry") && passed;
+	}
+
+	// The length prefix limits the XML, and one past the end of the block is clamped to it.
+	{
+		const auto xml = std::string_view("<Resource id=\"00000006\" type=\"Raster\" name=\"six\"/><Resource id=\"00000007\" type=\"Raster\" name=\"seven\"/>");
+		Bundle shorter;
+		passed = Check(Load(MakeTable(xml, static_cast<uint32_t>(xml.find("<Resource", 1))), shorter), "loading a short length prefix") && passed;
+		passed = Check(HasDebugInfo(shorter, 6, "six", "Raster") && !shorter.GetDebugInfoView(7).has_value(), "short length prefix") && passed;
+
+		Bundle longer;
+		passed = Check(Load(MakeTable(xml, 0xFFFFFFFF), longer), "loading a long length prefix") && passed;
+		passed = Check(HasDebugInfo(longer, 6, "six", "Raster") && HasDebugInfo(longer, 7, "seven", "Raster"), "long length prefix") && passed;
+	}
+
+	// Too short for the length prefix: no debug info, but the bundle loads.
+	{
+		Bundle bundle;
+		passed = Check(Load({ 0x10, 0x00 }, bundle), "loading a table shorter than its length prefix") && passed;
+		passed = Check(!bundle.GetDebugInfoView(1).has_value(), "table shorter than its length prefix") && passed;
+	}
+
+	std::remove(FileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
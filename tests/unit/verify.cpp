@@ -0,0 +1,141 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace libbndl;
+
+// Corrupts a generated, compressed BND2 bundle in different ways, and checks Verify reports the
+// damaged resource and block, on one thread and on several, or that Load refuses the file.
+
+namespace
+{
+	constexpr auto FileName = "verify.bundle";
+	constexpr auto CorruptFileName = "verify_corrupt.bundle";
+
+	// The BND2 header, and each entry of the ID block as 32-bit words.
+	constexpr size_t IDBlockOffsetPos = 0x14;
+	constexpr size_t FileBlockOffsetsPos = 0x18;
+	constexpr size_t IDEntrySize = 0x40;
+	constexpr size_t UncompressedSizeWord = 4;
+	constexpr size_t CompressedSizeWord = 7;
+	constexpr size_t OffsetWord = 10;
+
+	// Somewhere in the middle, so it's neither first nor last in the file.
+	constexpr size_t CorruptEntry = 50;
+
+	bool Check(bool condition, const std::string &what)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << what << std::endl;
+		return condition;
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string &fileName)
+	{
+		std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
+
+	bool WriteFile(const std::string &fileName, const std::vector<uint8_t> &data)
+	{
+		std::ofstream stream(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+		return !stream.fail();
+	}
+
+	uint32_t Get(const std::vector<uint8_t> &file, size_t pos)
+	{
+		return file[pos] | (file[pos + 1] << 8) | (file[pos + 2] << 16) | (uint32_t(file[pos + 3]) << 24);
+	}
+
+	void Set(std::vector<uint8_t> &file, size_t pos, uint32_t value)
+	{
+		for (auto i = 0; i < 4; i++)
+			file[pos + i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+
+	size_t WordPos(const std::vector<uint8_t> &file, size_t word)
+	{
+		return Get(file, IDBlockOffsetPos) + CorruptEntry * IDEntrySize + word * 4;
+	}
+
+	// Loads the corrupted copy and checks Verify reports block 0 of the corrupted entry, and
+	// nothing else.
+	bool Reports(const std::vector<uint8_t> &file, const std::function<void(std::vector<uint8_t> &)> &corrupt, const std::string &what)
+	{
+		auto corrupted = file;
+		corrupt(corrupted);
+		const auto resourceID = Get(corrupted, WordPos(corrupted, 0));
+
+		Bundle bundle;
+		if (!Check(WriteFile(CorruptFileName, corrupted) && bundle.Load(CorruptFileName), what + ": loading"))
+			return false;
+
+		auto passed = true;
+		for (const auto threadCount : { 1U, 4U })
+		{
+			const auto issues = bundle.Verify(threadCount);
+			passed = Check(!issues.empty(), what + ": reported") && passed;
+			for (const auto &issue : issues)
+				passed = Check(issue.resourceID == resourceID && issue.fileBlock == 0 && !issue.message.empty(), what + ": only the corrupted block") && passed;
+		}
+		return passed;
+	}
+}
+
+int main()
+{
+	GeneratorOptions options;
+	options.resourceCount = 100;
+	options.compressed = true;
+	options.dependencyDensity = 2.0;
+	Bundle bundle;
+	if (!Check(GenerateBundle(options, FileName) && bundle.Load(FileName), "generating"))
+		return EXIT_FAILURE;
+	auto passed = Check(bundle.Verify().empty(), "verifying the generated bundle");
+
+	const auto file = ReadFile(FileName);
+	const auto dataPos = [&file](const std::vector<uint8_t> &corrupted)
+	{
+		return Get(file, FileBlockOffsetsPos) + Get(corrupted, WordPos(corrupted, OffsetWord));
+	};
+
+	// Bytes in the middle of the deflate stream, so the zlib checksum doesn't match, if it even inflates.
+	passed = Reports(file, [&](std::vector<uint8_t> &corrupted)
+	{
+		const auto pos = dataPos(corrupted) + Get(corrupted, WordPos(corrupted, CompressedSizeWord)) / 2;
+		for (auto i = 0; i < 4; i++)
+			corrupted[pos + i] ^= 0x5A;
+	}, "corrupted data") && passed;
+
+	// The data is fine, but inflates to a different size than the stored one.
+	passed = Reports(file, [&](std::vector<uint8_t> &corrupted)
+	{
+		const auto pos = WordPos(corrupted, UncompressedSizeWord);
+		Set(corrupted, pos, Get(corrupted, pos) + 1);
+	}, "corrupted uncompressed size") && passed;
+
+	// Points into the middle of its own stream.
+	passed = Reports(file, [&](std::vector<uint8_t> &corrupted)
+	{
+		const auto pos = WordPos(corrupted, OffsetWord);
+		Set(corrupted, pos, Get(corrupted, pos) + 2);
+	}, "corrupted offset") && passed;
+
+	// Offsets past the end of the file are caught by Load.
+	auto pastEnd = file;
+	Set(pastEnd, WordPos(pastEnd, OffsetWord), static_cast<uint32_t>(file.size()));
+	Bundle refused;
+	passed = Check(WriteFile(CorruptFileName, pastEnd) && !refused.Load(CorruptFileName), "refusing an offset past the end") && passed;
+
+	std::remove(FileName);
+	std::remove(CorruptFileName);
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,236 @@
+#include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cxxopts.hpp>
+
+using namespace libbndl;
+
+namespace
+{
+	struct Settings
+	{
+		uint32_t entries;
+		uint32_t blockSize;
+		uint32_t iterations;
+		std::string filter;
+	};
+
+	struct Format
+	{
+		const char *name;
+		Bundle::MagicVersion magicVersion;
+		uint32_t revisionNumber;
+		Bundle::Platform platform;
+		bool compressed;
+	};
+
+	// Save only writes PC BND2 bundles, so there is no big endian BND2 case.
+	const Format Formats[] = {
+		{ "bnd2-pc", Bundle::BND2, 2, Bundle::PC, false },
+		{ "bnd2-pc-zlib", Bundle::BND2, 2, Bundle::PC, true },
+		{ "bndl-pc", Bundle::BNDL, 5, Bundle::PC, false },
+		{ "bndl-pc-zlib", Bundle::BNDL, 5, Bundle::PC, true },
+		{ "bndl-x360", Bundle::BNDL, 5, Bundle::Xbox360, false },
+		{ "bndl-x360-zlib", Bundle::BNDL, 5, Bundle::Xbox360, true },
+		{ "bndl-ps3", Bundle::BNDL, 5, Bundle::PS3, false },
+		{ "bndl-ps3-zlib", Bundle::BNDL, 5, Bundle::PS3, true },
+	};
+
+	GeneratorOptions MakeGeneratorOptions(const Settings &settings, Bundle::MagicVersion magicVersion, uint32_t revisionNumber,
+		Bundle::Platform platform, bool compressed)
+	{
+		GeneratorOptions options;
+		options.magicVersion = magicVersion;
+		options.revisionNumber = revisionNumber;
+		options.platform = platform;
+		options.compressed = compressed;
+		options.resourceCount = settings.entries;
+		options.minBlockSizes[0] = settings.blockSize;
+		options.maxBlockSizes[0] = settings.blockSize;
+		options.minBlockSizes[1] = settings.blockSize / 2;
+		options.maxBlockSizes[1] = settings.blockSize / 2;
+		return options;
+	}
+
+	// Runs body settings.iterations times and prints the best time, so scheduling noise doesn't
+	// count. bytes and ops are per iteration; either may be 0.
+	void Run(const Settings &settings, const std::string &name, uint64_t bytes, uint64_t ops, const std::function<bool()> &body)
+	{
+		if (name.find(settings.filter) == std::string::npos)
+			return;
+
+		auto best = std::chrono::steady_clock::duration::max();
+		for (auto i = 0U; i < settings.iterations; i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			if (!body())
+			{
+				std::printf("%-36s FAILED\n", name.c_str());
+				return;
+			}
+			best = std::min(best, std::chrono::steady_clock::now() - start);
+		}
+
+		const auto seconds = std::chrono::duration<double>(best).count();
+		std::printf("%-36s %10.3f ms", name.c_str(), seconds * 1000.0);
+		if (bytes > 0)
+			std::printf(" %10.1f MB/s", bytes / seconds / (1024.0 * 1024.0));
+		if (ops > 0)
+			std::printf(" %14.0f ops/s", ops / seconds);
+		std::printf("\n");
+	}
+
+	void BenchFormat(const Format &format, const Settings &settings, const std::filesystem::path &directory)
+	{
+		const auto fileName = (directory / (std::string("libbndl_bench_") + format.name + ".bundle")).string();
+		const auto savedName = fileName + ".saved";
+		if (!GenerateBundle(MakeGeneratorOptions(settings, format.magicVersion, format.revisionNumber, format.platform, format.compressed), fileName))
+		{
+			std::printf("%-36s FAILED to create\n", format.name);
+			return;
+		}
+		const auto fileSize = std::filesystem::file_size(fileName);
+		const auto prefix = std::string(format.name) + " ";
+
+		Run(settings, prefix + "Load", fileSize, 0, [&]()
+		{
+			Bundle bundle;
+			return bundle.Load(fileName);
+		});
+
+		Bundle bundle;
+		if (!bundle.Load(fileName))
+			return;
+
+		uint64_t uncompressedBytes = 0;
+		auto blocks = 0U;
+		for (const auto resourceID : bundle.GetResourceIDs())
+		{
+			for (auto j = 0U; j < 3; j++)
+			{
+				const auto binary = bundle.GetBinary(resourceID, j);
+				if (binary != nullptr)
+				{
+					uncompressedBytes += binary->size();
+					blocks++;
+				}
+			}
+		}
+
+		Run(settings, prefix + "GetBinary", uncompressedBytes, blocks, [&]()
+		{
+			for (const auto resourceID : bundle.GetResourceIDs())
+			{
+				for (auto j = 0U; j < 3; j++)
+					bundle.GetBinary(resourceID, j);
+			}
+			return true;
+		});
+
+		// The same reads with every buffer going back to a pool, so after the first iteration they
+		// reuse the memory of the earlier ones.
+		bundle.SetBufferPool(std::make_shared<BufferPool>());
+		Run(settings, prefix + "GetPooledBinary", uncompressedBytes, blocks, [&]()
+		{
+			for (const auto resourceID : bundle.GetResourceIDs())
+			{
+				for (auto j = 0U; j < 3; j++)
+					bundle.GetPooledBinary(resourceID, j);
+			}
+			return true;
+		});
+		bundle.SetBufferPool(nullptr);
+
+		Run(settings, prefix + "ListResourceIDsByType", 0, 1, [&]()
+		{
+			return !bundle.ListResourceIDsByType().empty();
+		});
+
+		// Replaces a tenth of the resources with data from another generated bundle, which compresses
+		// it in compressed bundles. Includes copying the data out of the other bundle.
+		const auto replaced = std::max(settings.entries / 10, 1U);
+		auto sourceOptions = MakeGeneratorOptions(settings, Bundle::BND2, 0, Bundle::PC, false);
+		sourceOptions.resourceCount = replaced;
+		sourceOptions.dependencyDensity = 0;
+		sourceOptions.seed = 1;
+		const auto source = GenerateBundle(sourceOptions);
+		const auto sourceIDs = source->ListResourceIDs();
+		const auto targetIDs = bundle.ListResourceIDs();
+		Run(settings, prefix + "ReplaceResource", uint64_t(replaced) * (settings.blockSize + settings.blockSize / 2), replaced, [&]()
+		{
+			for (auto i = 0U; i < replaced; i++)
+			{
+				auto data = source->GetData(sourceIDs[i]);
+				if (!data || !bundle.ReplaceResource(targetIDs[i], std::move(*data)))
+					return false;
+			}
+			return true;
+		});
+
+		Run(settings, prefix + "Save", fileSize, 0, [&]()
+		{
+			return bundle.Save(savedName);
+		});
+
+		std::filesystem::remove(fileName);
+		std::filesystem::remove(savedName);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	cxxopts::Options options("libbndl_bench", "Measures the throughput of libbndl's hot paths on synthetic bundles.");
+	options.add_options()
+		("n,entries", "Resources per bundle", cxxopts::value<uint32_t>()->default_value("2000"))
+		("b,block-size", "Size of each resource's main block in bytes; the secondary block is half that", cxxopts::value<uint32_t>()->default_value("16384"))
+		("i,iterations", "Runs per benchmark; the fastest one is reported", cxxopts::value<uint32_t>()->default_value("5"))
+		("f,filter", "Only run benchmarks whose name contains this", cxxopts::value<std::string>()->default_value(""))
+		("d,directory", "Where the bundles are written", cxxopts::value<std::string>());
+
+	auto parsedOptions = options.parse(argc, argv);
+
+	Settings settings;
+	settings.entries = std::max(parsedOptions["entries"].as<uint32_t>(), 1U);
+	settings.blockSize = parsedOptions["block-size"].as<uint32_t>();
+	settings.iterations = std::max(parsedOptions["iterations"].as<uint32_t>(), 1U);
+	settings.filter = parsedOptions["filter"].as<std::string>();
+
+	std::error_code error;
+	const auto directory = parsedOptions.count("directory") ? std::filesystem::path(parsedOptions["directory"].as<std::string>())
+		: std::filesystem::temp_directory_path(error);
+	if (error || !std::filesystem::is_directory(directory))
+	{
+		std::cout << "No usable directory for the bundles." << std::endl << options.help() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::printf("%u resources, %u + %u bytes each, best of %u\n\n", settings.entries, settings.blockSize, settings.blockSize / 2, settings.iterations);
+
+	std::vector<std::string> names(settings.entries);
+	uint64_t nameBytes = 0;
+	for (auto i = 0U; i < settings.entries; i++)
+	{
+		names[i] = "generated://Renderable/" + std::to_string(i);
+		nameBytes += names[i].size();
+	}
+	Run(settings, "HashResourceName", nameBytes, names.size(), [&]()
+	{
+		// Stored so the loop isn't optimized away.
+		static volatile uint32_t combined;
+		for (const auto &name : names)
+			combined = combined ^ Bundle::HashResourceName(name);
+		return true;
+	});
+
+	for (const auto &format : Formats)
+		BenchFormat(format, settings, directory);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+#include "extract.hpp"
+#include "manifest.hpp"
+#include "workers.hpp"
+#include "parallel.hpp"
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+
+using namespace libbndl;
+
+namespace
+{
+	std::string Hex(uint32_t value)
+	{
+		char buffer[9];
+		std::snprintf(buffer, sizeof(buffer), "%08x", value);
+		return buffer;
+	}
+
+	// Windows reserves these device names in every folder, with or without an extension.
+	bool IsReservedName(std::string_view segment)
+	{
+		auto stem = segment.substr(0, segment.find('.'));
+		while (!stem.empty() && stem.back() == ' ')
+			stem.remove_suffix(1);
+
+		std::string upper(stem);
+		for (auto &c : upper)
+			c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		if (upper == "CON" || upper == "PRN" || upper == "AUX" || upper == "NUL")
+			return true;
+		return upper.size() == 4 && (upper.compare(0, 3, "COM") == 0 || upper.compare(0, 3, "LPT") == 0)
+			&& upper[3] >= '0' && upper[3] <= '9';
+	}
+
+	// Turns a debug name like "gamedb://burnout5/Foo/Bar.Texture?ID=1" into a relative path that's
+	// valid on every platform: the scheme becomes a folder, and segments lose characters Windows
+	// rejects, trailing dots and spaces, any meaning as "." or "..", and reserved device names.
+	std::string PathFromName(std::string_view name)
+	{
+		std::string path;
+		const auto scheme = name.find("://");
+		std::string full(name);
+		if (scheme != std::string_view::npos)
+			full.replace(scheme, 3, "/");
+
+		size_t pos = 0;
+		while (pos <= full.size())
+		{
+			auto end = full.find_first_of("/\\", pos);
+			if (end == std::string::npos)
+				end = full.size();
+
+			auto segment = full.substr(pos, end - pos);
+			for (auto &c : segment)
+			{
+				if (static_cast<unsigned char>(c) < 0x20 || std::string_view("<>:\"|?*").find(c) != std::string_view::npos)
+					c = '_';
+			}
+			while (!segment.empty() && (segment.back() == '.' || segment.back() == ' '))
+				segment.pop_back();
+			if (IsReservedName(segment))
+				segment.insert(0, 1, '_');
+
+			if (!segment.empty())
+			{
+				if (!path.empty())
+					path += '/';
+				path += segment;
+			}
+			pos = end + 1;
+		}
+		return path;
+	}
+
+	std::string ToLower(std::string str)
+	{
+		for (auto &c : str)
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		return str;
+	}
+
+	bool WriteFile(const std::filesystem::path &fileName, const std::vector<uint8_t> &data)
+	{
+		std::ofstream stream(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+		stream.close();
+		return !stream.fail();
+	}
+}
+
+bool ExtractBundle(const Bundle &bundle, const std::filesystem::path &folder, uint32_t threadCount, size_t memoryBudget)
+{
+	Manifest manifest;
+	manifest.magicVersion = bundle.GetMagicVersion();
+	manifest.revisionNumber = bundle.GetRevisionNumber();
+	manifest.platform = bundle.GetPlatform();
+	manifest.flags = bundle.GetFlags();
+
+	// Paths are decided up front, in ID order, so they don't depend on thread timing. Paths only
+	// differing in case would clash on Windows and macOS, so those get the ID appended.
+	std::unordered_set<std::string> usedPaths;
+	for (const auto resourceID : bundle.GetResourceIDs())
+	{
+		ManifestResource resource {};
+		resource.resourceID = resourceID;
+		resource.resourceType = *bundle.GetResourceType(resourceID);
+
+		const auto debugInfo = bundle.GetDebugInfoView(resourceID);
+		resource.hasDebugInfo = debugInfo.has_value();
+		if (debugInfo)
+		{
+			resource.name = debugInfo->name;
+			resource.typeName = debugInfo->typeName;
+			resource.path = PathFromName(debugInfo->name);
+		}
+		if (resource.path.empty())
+		{
+			const auto typeName = Bundle::GetResourceTypeName(resource.resourceType);
+			resource.path = "_unnamed/" + (typeName.empty() ? Hex(resource.resourceType) : std::string(typeName)) + '/' + Hex(resourceID);
+		}
+		if (!usedPaths.insert(ToLower(resource.path)).second)
+		{
+			resource.path += '_' + Hex(resourceID);
+			usedPaths.insert(ToLower(resource.path));
+		}
+
+		manifest.resources.push_back(std::move(resource));
+	}
+
+	// Creating the folders here means the workers never race to create the same one.
+	std::error_code error;
+	std::filesystem::create_directories(folder, error);
+	for (const auto &resource : manifest.resources)
+	{
+		const auto parent = (folder / std::filesystem::u8path(resource.path)).parent_path();
+		if (!error)
+			std::filesystem::create_directories(parent, error);
+	}
+	if (error)
+	{
+		std::cout << "Failed to create folders in " << folder.string() << ": " << error.message() << std::endl;
+		return false;
+	}
+
+	MemoryBudget budget(memoryBudget);
+	std::mutex outputMutex;
+	std::atomic<bool> extracted = true;
+	parallel::ForEach(manifest.resources.size(), threadCount, [&](size_t i)
+	{
+		auto &resource = manifest.resources[i];
+
+		auto size = size_t(0);
+		for (auto j = 0U; j < 3; j++)
+			size += bundle.GetUncompressedSize(resource.resourceID, j).value_or(0);
+		const auto reserved = budget.Acquire(size);
+		auto data = bundle.GetData(resource.resourceID);
+		auto written = data.has_value();
+		if (data)
+		{
+			for (auto j = 0; j < 3; j++)
+			{
+				resource.alignments[j] = data->alignments[j];
+				const auto &block = data->fileBlockData[j];
+				if (block != nullptr && !block->empty())
+					written = written && WriteFile(folder / std::filesystem::u8path(BlockFileName(resource.path, j)), *block);
+			}
+			resource.dependencies = std::move(data->dependencies);
+		}
+		data.reset();
+		budget.Release(reserved);
+
+		if (!written)
+		{
+			extracted = false;
+			std::lock_guard<std::mutex> lock(outputMutex);
+			std::cout << "Failed to extract " << Hex(resource.resourceID) << std::endl;
+		}
+	});
+
+	if (!extracted)
+		return false;
+
+	if (!WriteManifest((folder / ManifestFileName).string(), manifest))
+	{
+		std::cout << "Failed to write the manifest" << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <cstdint>
+#include <filesystem>
+
+// Writes every block of every resource to its own file under folder, named after the resource's
+// debug name (or type and ID without one), plus a manifest with everything else. Blocks are read,
+// decompressed and written on threadCount threads, holding at most memoryBudget bytes at once.
+bool ExtractBundle(const libbndl::Bundle &bundle, const std::filesystem::path &folder, uint32_t threadCount, size_t memoryBudget);
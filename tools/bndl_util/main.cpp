@@ -1,6 +1,14 @@
 #include <libbndl/bundle.hpp>
+#include <libbndl/generator.hpp>
+#include "extract.hpp"
+#include "pack.hpp"
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cxxopts.hpp>
 
 using namespace libbndl;
@@ -12,8 +20,24 @@ int main(int argc, char** argv)
 		("e,extract", "Extract the archive")
 		("p,pack", "Pack a folder structure to a bundle archive")
 		("f,file", "Name of the archive that should be extracted/generated", cxxopts::value<std::string>())
+		("o,folder", "Folder to extract to or pack from", cxxopts::value<std::string>())
 		("s,search", "Search for an entry", cxxopts::value<std::string>())
-		("l,list", "List all entries");
+		("l,list", "List all entries")
+		("v,verify", "Check the archive for corrupt or inconsistent data")
+		("g,generate", "Generate a synthetic archive for testing")
+		("d,dictionary", "Newline-separated candidate names used to name entries without debug info", cxxopts::value<std::string>())
+		("t,threads", "Number of worker threads (0 for all hardware threads)", cxxopts::value<uint32_t>()->default_value("0"))
+		("memory", "Most block data in flight at once when extracting or packing, in MiB. Packing also keeps the packed bundle in memory until it is written", cxxopts::value<uint32_t>()->default_value("512"));
+	options.add_options("Generate")
+		("format", "Archive format: bnd2 or bndl", cxxopts::value<std::string>()->default_value("bnd2"))
+		("platform", "Platform: pc, x360 or ps3", cxxopts::value<std::string>()->default_value("pc"))
+		("revision", "Format revision (0 for the newest)", cxxopts::value<uint32_t>()->default_value("0"))
+		("compress", "Compress the resources")
+		("count", "Number of resources", cxxopts::value<uint32_t>()->default_value("1000"))
+		("max-size", "Largest main block in bytes; secondary blocks are up to four times that", cxxopts::value<uint32_t>()->default_value("16384"))
+		("dependencies", "Average number of dependencies per resource", cxxopts::value<double>()->default_value("1"))
+		("no-debug-info", "Leave out the resource string table")
+		("seed", "Seed for the generated data", cxxopts::value<uint64_t>()->default_value("0"));
 
 	auto parsedOptions = options.parse(argc, argv);
 	if (parsedOptions.count("file") == 0)
@@ -22,52 +46,192 @@ int main(int argc, char** argv)
 		return EXIT_FAILURE;
 	}
 
-	bool extract = parsedOptions["pack"].as<bool>();
+	bool extract = parsedOptions["extract"].as<bool>();
 	bool pack = parsedOptions["pack"].as<bool>();
 	bool list = parsedOptions["list"].as<bool>();
+	bool verify = parsedOptions["verify"].as<bool>();
+	bool generate = parsedOptions["generate"].as<bool>();
 	std::string file = parsedOptions["file"].as<std::string>();
-	std::string search = parsedOptions["search"].as<std::string>();
+	std::string search = parsedOptions.count("search") ? parsedOptions["search"].as<std::string>() : std::string();
+	std::string dictionary = parsedOptions.count("dictionary") ? parsedOptions["dictionary"].as<std::string>() : std::string();
+	std::string folder = parsedOptions.count("folder") ? parsedOptions["folder"].as<std::string>() : std::string();
+	size_t memory = size_t(parsedOptions["memory"].as<uint32_t>()) * 1024 * 1024;
+	uint32_t threads = parsedOptions["threads"].as<uint32_t>();
 	bool bsearch = search.size() > 0;
 	
-	if ((pack + extract + list + bsearch) != 1)
+	if ((pack + extract + list + verify + generate + bsearch) != 1)
 	{
 		std::cout << "Please specify exactly one operation that should be executed." << std::endl
 		<< options.help() << std::endl;
 		return EXIT_FAILURE;
 	}
 
+	if (generate)
+	{
+		GeneratorOptions generatorOptions;
+		const auto format = parsedOptions["format"].as<std::string>();
+		const auto platform = parsedOptions["platform"].as<std::string>();
+		if (format == "bnd2")
+			generatorOptions.magicVersion = Bundle::BND2;
+		else if (format == "bndl")
+			generatorOptions.magicVersion = Bundle::BNDL;
+		else
+		{
+			std::cout << "Unknown format " << format << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (platform == "pc")
+			generatorOptions.platform = Bundle::PC;
+		else if (platform == "x360")
+			generatorOptions.platform = Bundle::Xbox360;
+		else if (platform == "ps3")
+			generatorOptions.platform = Bundle::PS3;
+		else
+		{
+			std::cout << "Unknown platform " << platform << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		generatorOptions.revisionNumber = parsedOptions["revision"].as<uint32_t>();
+		generatorOptions.compressed = parsedOptions["compress"].as<bool>();
+		generatorOptions.resourceCount = parsedOptions["count"].as<uint32_t>();
+		const auto maxSize = parsedOptions["max-size"].as<uint32_t>();
+		generatorOptions.minBlockSizes[0] = std::min(generatorOptions.minBlockSizes[0], maxSize);
+		generatorOptions.maxBlockSizes[0] = maxSize;
+		generatorOptions.maxBlockSizes[1] = maxSize * 4;
+		generatorOptions.dependencyDensity = parsedOptions["dependencies"].as<double>();
+		generatorOptions.resourceStringTable = !parsedOptions["no-debug-info"].as<bool>();
+		generatorOptions.seed = parsedOptions["seed"].as<uint64_t>();
+		generatorOptions.threadCount = threads;
+
+		if (!GenerateBundle(generatorOptions, file))
+		{
+			std::cout << "Failed to generate " << file << " (BND2 is PC only; compression needs BNDL revision 4 or later, and bundles must be smaller than 4 GiB)" << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::cout << "Generated " << file << std::endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (pack)
+	{
+		if (folder.empty())
+		{
+			std::cout << "Please specify a folder to pack." << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!PackBundle(std::filesystem::u8path(folder), file, threads, memory))
+			return EXIT_FAILURE;
+		std::cout << "Packed " << folder << " to " << file << std::endl;
+		return EXIT_SUCCESS;
+	}
+
 	Bundle arch;
-	if (!pack)
+	if (!arch.Load(file))
+	{
+		std::cout << "Failed to open " << file << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (!dictionary.empty())
 	{
-		if (!arch.Load(file))
+		std::ifstream dictionaryStream(dictionary, std::ios::in | std::ios::binary);
+		if (dictionaryStream.fail())
 		{
-			std::cout << "Failed to open " << file << std::endl;
+			std::cout << "Failed to open " << dictionary << std::endl;
 			return EXIT_FAILURE;
 		}
 
-		if (list)
+		const auto names = std::string(std::istreambuf_iterator<char>(dictionaryStream), std::istreambuf_iterator<char>());
+		std::vector<std::string_view> candidates;
+		for (size_t pos = 0, end; pos < names.size(); pos = end + 1)
+		{
+			end = std::min(names.find('\n', pos), names.size());
+			auto name = std::string_view(names).substr(pos, end - pos);
+			if (!name.empty() && name.back() == '\r')
+				name.remove_suffix(1);
+			if (!name.empty())
+				candidates.push_back(name);
+		}
+
+		const auto recovered = arch.RecoverDebugInfo(candidates, threads);
+		std::cerr << "Recovered " << recovered << " names from " << candidates.size() << " candidates." << std::endl;
+	}
+
+	if (extract)
+	{
+		if (folder.empty())
+		{
+			std::cout << "Please specify a folder to extract to." << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!ExtractBundle(arch, std::filesystem::u8path(folder), threads, memory))
+			return EXIT_FAILURE;
+		std::cout << "Extracted " << arch.GetResourceIDs().size() << " resources to " << folder << std::endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (verify)
+	{
+		const auto issues = arch.Verify(threads);
+		for (const auto &issue : issues)
+		{
+			std::cout << std::hex << std::setw(8) << std::setfill('0') << issue.resourceID << std::dec << std::setfill(' ');
+			if (issue.fileBlock >= 0)
+				std::cout << " block " << issue.fileBlock;
+			std::cout << ": " << issue.message << '\n';
+		}
+		std::cout << file << ": " << (issues.empty() ? "OK" : std::to_string(issues.size()) + " problem(s)") << std::endl;
+		return issues.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Debug info is returned as views into the bundle, so printing doesn't allocate per entry.
+	const auto printEntry = [&arch](uint32_t resourceID)
+	{
+		const auto debugInfo = arch.GetDebugInfoView(resourceID);
+		const auto resourceType = *arch.GetResourceType(resourceID);
+		std::cout << std::left << std::setw(70);
+		if (debugInfo)
+			std::cout << debugInfo->name;
+		else
+			std::cout << std::hex << resourceID << std::dec;
+		std::cout << std::right;
+		if (debugInfo)
+			std::cout << debugInfo->typeName;
+		else
+			std::cout << std::hex << resourceType << std::dec;
+		std::cout << '\n';
+	};
+
+	if (list || bsearch)
+	{
+		std::cout.fill('-');
+		std::cout << std::left << std::setw(70) << "NAME" << std::right << "FILE TYPE" << std::endl;
+		std::cout.fill(' ');
+	}
+
+	if (list)
+	{
+		for (const auto &resourceID : arch.ListResourceIDs())
+			printEntry(resourceID);
+	}
+	else if (bsearch)
+	{
+		// Match names case-insensitively, or the resource ID if the search is a hex number.
+		char *searchEnd;
+		const auto searchID = std::strtoul(search.c_str(), &searchEnd, 16);
+		const auto searchIsID = *searchEnd == '\0';
+		const auto equalsIgnoreCase = [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); };
+
+		for (const auto &resourceID : arch.ListResourceIDs())
 		{
-			std::cout.fill('-');
-			std::cout << std::left << std::setw(70) << "NAME" << std::right << "FILE TYPE" << std::endl;
-			std::cout.fill(' ');
-			for (const auto &resourceID : arch.ListResourceIDs())
-			{
-				const auto debugInfo = arch.GetDebugInfo(resourceID);
-				const auto resourceType = *arch.GetResourceType(resourceID);
-				std::ostringstream name;
-				if (debugInfo)
-					name << debugInfo->name;
-				else
-					name << std::hex << resourceID;
-				std::ostringstream typeName;
-				if (debugInfo)
-					typeName << debugInfo->typeName;
-				else
-					typeName << std::hex << resourceType;
-				std::cout << std::left << std::setw(70) << name.str() << std::right << typeName.str() << std::endl;
-			}
+			const auto debugInfo = arch.GetDebugInfoView(resourceID);
+			const auto nameMatches = debugInfo && std::search(debugInfo->name.begin(), debugInfo->name.end(), search.begin(), search.end(), equalsIgnoreCase) != debugInfo->name.end();
+			if (nameMatches || (searchIsID && searchID == resourceID))
+				printEntry(resourceID);
 		}
 	}
 
+	std::cout.flush();
 	return 0;
 }
@@ -0,0 +1,219 @@
+#include "manifest.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace libbndl;
+
+namespace
+{
+	constexpr auto ManifestHeader = "# bndl_util manifest 1";
+
+	const char *const BlockSuffixes[3] = { ".primary", ".secondary", ".tertiary" };
+
+	// Names may contain anything, but fields are separated by tabs and records by newlines.
+	std::string Escape(const std::string &str)
+	{
+		std::string escaped;
+		escaped.reserve(str.size());
+		for (const auto c : str)
+		{
+			switch (c)
+			{
+			case '\\': escaped += "\\\\"; break;
+			case '\t': escaped += "\\t"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			default: escaped += c; break;
+			}
+		}
+		return escaped;
+	}
+
+	bool Unescape(const std::string &str, std::string &unescaped)
+	{
+		unescaped.clear();
+		for (size_t i = 0; i < str.size(); i++)
+		{
+			if (str[i] != '\\')
+			{
+				unescaped += str[i];
+				continue;
+			}
+			if (++i == str.size())
+				return false;
+			switch (str[i])
+			{
+			case '\\': unescaped += '\\'; break;
+			case 't': unescaped += '\t'; break;
+			case 'n': unescaped += '\n'; break;
+			case 'r': unescaped += '\r'; break;
+			default: return false;
+			}
+		}
+		return true;
+	}
+
+	std::vector<std::string> SplitFields(const std::string &line)
+	{
+		std::vector<std::string> fields;
+		for (size_t pos = 0;;)
+		{
+			const auto end = line.find('\t', pos);
+			fields.push_back(line.substr(pos, end - pos));
+			if (end == std::string::npos)
+				return fields;
+			pos = end + 1;
+		}
+	}
+
+	bool ParseHex(const std::string &field, uint32_t &value)
+	{
+		if (field.empty() || field.size() > 8)
+			return false;
+		char *end;
+		value = static_cast<uint32_t>(std::strtoul(field.c_str(), &end, 16));
+		return *end == '\0';
+	}
+
+	bool ParseDecimal(const std::string &field, uint32_t &value)
+	{
+		if (field.empty())
+			return false;
+		char *end;
+		const auto parsed = std::strtoull(field.c_str(), &end, 10);
+		value = static_cast<uint32_t>(parsed);
+		return *end == '\0' && parsed <= 0xFFFFFFFFULL;
+	}
+
+	std::string Hex(uint32_t value)
+	{
+		char buffer[9];
+		std::snprintf(buffer, sizeof(buffer), "%08x", value);
+		return buffer;
+	}
+
+	// "-" or comma-separated "<resource ID>:<internal offset>" pairs.
+	bool ParseDependencies(const std::string &field, std::vector<Bundle::Dependency> &dependencies)
+	{
+		dependencies.clear();
+		if (field == "-")
+			return true;
+
+		std::istringstream stream(field);
+		std::string pair;
+		while (std::getline(stream, pair, ','))
+		{
+			const auto colon = pair.find(':');
+			Bundle::Dependency dependency;
+			if (colon == std::string::npos || !ParseHex(pair.substr(0, colon), dependency.resourceID)
+				|| !ParseHex(pair.substr(colon + 1), dependency.internalOffset))
+				return false;
+			dependencies.push_back(dependency);
+		}
+		return true;
+	}
+}
+
+std::string BlockFileName(const std::string &path, int fileBlock)
+{
+	return path + BlockSuffixes[fileBlock];
+}
+
+// format	<bnd2|bndl>	<revision>	<platform>	<flags>
+// resource	<ID>	<type>	<alignment 0>	<alignment 1>	<alignment 2>	<path>	<dependencies>	[<name>	<type name>]
+bool WriteManifest(const std::string &fileName, const Manifest &manifest)
+{
+	std::ofstream stream(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (stream.fail())
+		return false;
+
+	const auto platform = (manifest.platform == Bundle::Xbox360) ? "x360" : (manifest.platform == Bundle::PS3) ? "ps3" : "pc";
+	stream << ManifestHeader << '\n';
+	stream << "format\t" << ((manifest.magicVersion == Bundle::BNDL) ? "bndl" : "bnd2") << '\t' << manifest.revisionNumber
+		<< '\t' << platform << '\t' << Hex(manifest.flags) << '\n';
+
+	for (const auto &resource : manifest.resources)
+	{
+		stream << "resource\t" << Hex(resource.resourceID) << '\t' << Hex(resource.resourceType);
+		for (const auto alignment : resource.alignments)
+			stream << '\t' << alignment;
+		stream << '\t' << Escape(resource.path) << '\t';
+
+		if (resource.dependencies.empty())
+			stream << '-';
+		for (size_t i = 0; i < resource.dependencies.size(); i++)
+		{
+			const auto &dependency = resource.dependencies[i];
+			stream << ((i > 0) ? "," : "") << Hex(dependency.resourceID) << ':' << Hex(dependency.internalOffset);
+		}
+
+		if (resource.hasDebugInfo)
+			stream << '\t' << Escape(resource.name) << '\t' << Escape(resource.typeName);
+		stream << '\n';
+	}
+
+	stream.close();
+	return !stream.fail();
+}
+
+bool ReadManifest(const std::string &fileName, Manifest &manifest)
+{
+	std::ifstream stream(fileName, std::ios::in | std::ios::binary);
+	if (stream.fail())
+	{
+		std::cerr << "Failed to open " << fileName << std::endl;
+		return false;
+	}
+
+	manifest.resources.clear();
+	auto hasFormat = false;
+	std::string line;
+	for (auto lineNumber = 1U; std::getline(stream, line); lineNumber++)
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		const auto fields = SplitFields(line);
+		auto valid = false;
+		if (fields[0] == "format" && fields.size() == 5 && !hasFormat)
+		{
+			uint32_t flags = 0;
+			valid = (fields[1] == "bnd2" || fields[1] == "bndl") && ParseDecimal(fields[2], manifest.revisionNumber)
+				&& (fields[3] == "pc" || fields[3] == "x360" || fields[3] == "ps3") && ParseHex(fields[4], flags);
+			manifest.magicVersion = (fields[1] == "bndl") ? Bundle::BNDL : Bundle::BND2;
+			manifest.platform = (fields[3] == "x360") ? Bundle::Xbox360 : (fields[3] == "ps3") ? Bundle::PS3 : Bundle::PC;
+			manifest.flags = static_cast<Bundle::Flags>(flags);
+			hasFormat = valid;
+		}
+		else if (fields[0] == "resource" && (fields.size() == 8 || fields.size() == 10))
+		{
+			ManifestResource resource;
+			uint32_t resourceType = 0;
+			valid = ParseHex(fields[1], resource.resourceID) && ParseHex(fields[2], resourceType)
+				&& ParseDecimal(fields[3], resource.alignments[0]) && ParseDecimal(fields[4], resource.alignments[1])
+				&& ParseDecimal(fields[5], resource.alignments[2]) && Unescape(fields[6], resource.path) && !resource.path.empty()
+				&& ParseDependencies(fields[7], resource.dependencies);
+			resource.resourceType = static_cast<Bundle::ResourceType>(resourceType);
+			resource.hasDebugInfo = fields.size() == 10;
+			if (resource.hasDebugInfo)
+				valid = valid && Unescape(fields[8], resource.name) && Unescape(fields[9], resource.typeName);
+			if (valid)
+				manifest.resources.push_back(std::move(resource));
+		}
+
+		if (!valid)
+		{
+			std::cerr << fileName << ':' << lineNumber << ": invalid line" << std::endl;
+			return false;
+		}
+	}
+
+	if (!hasFormat)
+		std::cerr << fileName << ": missing format line" << std::endl;
+	return hasFormat;
+}
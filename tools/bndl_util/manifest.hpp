@@ -0,0 +1,37 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <string>
+#include <vector>
+
+// Everything about an extracted bundle that isn't in the block files, so it can be packed again.
+// Stored as tab-separated text, one line per resource, so diffs and hand edits stay readable.
+
+struct ManifestResource
+{
+	uint32_t resourceID;
+	libbndl::Bundle::ResourceType resourceType;
+	uint32_t alignments[3];
+	std::vector<libbndl::Bundle::Dependency> dependencies;
+	std::string path; // relative to the manifest, without the block suffix
+	bool hasDebugInfo;
+	std::string name;
+	std::string typeName;
+};
+
+struct Manifest
+{
+	libbndl::Bundle::MagicVersion magicVersion;
+	uint32_t revisionNumber;
+	libbndl::Bundle::Platform platform;
+	libbndl::Bundle::Flags flags;
+	std::vector<ManifestResource> resources;
+};
+
+constexpr auto ManifestFileName = "bundle.manifest";
+
+// The file block i of a resource is stored in.
+std::string BlockFileName(const std::string &path, int fileBlock);
+
+bool WriteManifest(const std::string &fileName, const Manifest &manifest);
+// Reports the line of the first error to std::cerr.
+bool ReadManifest(const std::string &fileName, Manifest &manifest);
@@ -0,0 +1,175 @@
+#include "pack.hpp"
+#include "manifest.hpp"
+#include "workers.hpp"
+#include "parallel.hpp"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace libbndl;
+
+namespace
+{
+	// Manifests may be edited by hand, so make sure paths stay inside the folder.
+	bool IsContained(const std::string &path)
+	{
+		const auto relative = std::filesystem::u8path(path);
+		if (relative.is_absolute() || relative.has_root_name())
+			return false;
+		for (const auto &segment : relative)
+		{
+			if (segment == "..")
+				return false;
+		}
+		return true;
+	}
+
+	// Missing files are empty blocks.
+	bool ReadBlock(const std::filesystem::path &fileName, std::unique_ptr<std::vector<uint8_t>> &block)
+	{
+		std::error_code error;
+		const auto status = std::filesystem::status(fileName, error);
+		if (status.type() == std::filesystem::file_type::not_found)
+			return true;
+		if (status.type() != std::filesystem::file_type::regular)
+			return false;
+
+		std::ifstream stream(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+		if (stream.fail())
+			return false;
+
+		const auto size = static_cast<size_t>(stream.tellg());
+		block = std::make_unique<std::vector<uint8_t>>(size);
+		stream.seekg(0);
+		stream.read(reinterpret_cast<char *>(block->data()), static_cast<std::streamsize>(size));
+		return !stream.fail();
+	}
+}
+
+bool PackBundle(const std::filesystem::path &folder, const std::string &fileName, uint32_t threadCount, size_t memoryBudget)
+{
+	Manifest manifest;
+	if (!ReadManifest((folder / ManifestFileName).string(), manifest))
+		return false;
+
+	if (manifest.magicVersion == Bundle::BND2 && manifest.platform != Bundle::PC)
+	{
+		std::cerr << "BND2 bundles can only be packed for PC." << std::endl;
+		return false;
+	}
+
+	for (const auto &resource : manifest.resources)
+	{
+		if (!IsContained(resource.path))
+		{
+			std::cerr << "Resource path " << resource.path << " is outside the folder." << std::endl;
+			return false;
+		}
+	}
+
+	Bundle bundle(manifest.magicVersion, manifest.revisionNumber, manifest.platform, manifest.flags);
+	// Blocks are compressed a batch at a time, in parallel, rather than one by one as they're added.
+	bundle.SetDeferredCompression(true);
+
+	std::vector<uint64_t> sizes(manifest.resources.size());
+	parallel::ForEach(manifest.resources.size(), threadCount, [&](size_t i)
+	{
+		for (auto j = 0; j < 3; j++)
+		{
+			std::error_code error;
+			const auto size = std::filesystem::file_size(folder / std::filesystem::u8path(BlockFileName(manifest.resources[i].path, j)), error);
+			if (!error)
+				sizes[i] += size;
+		}
+	});
+
+	// One batch is read while the one before it is compressed, so each gets half the budget.
+	std::vector<std::pair<size_t, size_t>> batches;
+	for (size_t batchStart = 0; batchStart < manifest.resources.size();)
+	{
+		auto batchEnd = batchStart + 1;
+		auto batchSize = sizes[batchStart];
+		while (batchEnd < manifest.resources.size() && batchSize + sizes[batchEnd] <= memoryBudget / 2)
+			batchSize += sizes[batchEnd++];
+		batches.emplace_back(batchStart, batchEnd);
+		batchStart = batchEnd;
+	}
+
+	std::mutex outputMutex;
+	const auto readBatch = [&](size_t batchIndex, std::vector<Bundle::EntryData> &batch)
+	{
+		const auto batchStart = batches[batchIndex].first;
+		batch.clear();
+		batch.resize(batches[batchIndex].second - batchStart);
+		std::atomic<bool> read = true;
+		parallel::ForEach(batch.size(), threadCount, [&](size_t i)
+		{
+			const auto &resource = manifest.resources[batchStart + i];
+			auto &data = batch[i];
+			for (auto j = 0; j < 3; j++)
+			{
+				data.alignments[j] = resource.alignments[j];
+				const auto blockName = BlockFileName(resource.path, j);
+				if (!ReadBlock(folder / std::filesystem::u8path(blockName), data.fileBlockData[j]))
+				{
+					read = false;
+					std::lock_guard<std::mutex> lock(outputMutex);
+					std::cerr << "Failed to read " << blockName << std::endl;
+				}
+			}
+			data.dependencies = resource.dependencies;
+		});
+		return read.load();
+	};
+
+	std::vector<Bundle::EntryData> batch;
+	std::vector<Bundle::EntryData> nextBatch;
+	auto read = batches.empty() || readBatch(0, batch);
+	for (size_t batchIndex = 0; read && batchIndex < batches.size(); batchIndex++)
+	{
+		auto nextRead = true;
+		std::thread reader;
+		if (batchIndex + 1 < batches.size())
+			reader = std::thread([&]() { nextRead = readBatch(batchIndex + 1, nextBatch); });
+
+		// Adding and compressing touch only the bundle, and reading only nextBatch.
+		auto added = true;
+		for (size_t i = 0; added && i < batch.size(); i++)
+		{
+			const auto &resource = manifest.resources[batches[batchIndex].first + i];
+			added = bundle.AddResource(resource.resourceID, std::move(batch[i]), resource.resourceType)
+				&& (!resource.hasDebugInfo || bundle.AddDebugInfo(resource.resourceID, resource.name, resource.typeName));
+			if (!added)
+			{
+				std::lock_guard<std::mutex> lock(outputMutex);
+				std::cerr << "Failed to add resource " << std::hex << resource.resourceID << std::dec << std::endl;
+			}
+		}
+		batch.clear();
+		if (added && !bundle.CompressDeferredBlocks(threadCount))
+		{
+			added = false;
+			std::lock_guard<std::mutex> lock(outputMutex);
+			std::cerr << "Failed to compress resources" << std::endl;
+		}
+
+		if (reader.joinable())
+			reader.join();
+		read = added && nextRead;
+		std::swap(batch, nextBatch);
+	}
+	if (!read)
+		return false;
+
+	if (!bundle.Save(fileName))
+	{
+		std::cerr << "Failed to save " << fileName << std::endl;
+		return false;
+	}
+
+	return true;
+}
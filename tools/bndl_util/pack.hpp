@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Builds a bundle from a folder written by ExtractBundle, using its manifest. Block files are
+// read on threadCount threads in batches, and each batch is compressed in parallel while the next
+// one is read. The two batches in flight share memoryBudget bytes, but the bundle keeps all the
+// compressed data until it is saved, so peak memory also grows with the size of the bundle.
+bool PackBundle(const std::filesystem::path &folder, const std::string &fileName, uint32_t threadCount, size_t memoryBudget);
@@ -0,0 +1,38 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// Limits how many bytes the workers hold at once. A request larger than the whole budget waits
+// for everything else to be released and then goes ahead alone.
+class MemoryBudget
+{
+public:
+	explicit MemoryBudget(size_t limit) : m_limit(std::max<size_t>(limit, 1)), m_available(m_limit) {}
+
+	// Returns the amount actually taken, which is what must be released.
+	size_t Acquire(size_t size)
+	{
+		size = std::min(size, m_limit);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_released.wait(lock, [this, size]() { return m_available >= size; });
+		m_available -= size;
+		return size;
+	}
+
+	void Release(size_t size)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_available += size;
+		}
+		m_released.notify_all();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_released;
+	size_t m_limit;
+	size_t m_available;
+};